@@ -1,12 +1,20 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
 #include <cmath>
+#include <filesystem>
 #include <fstream>
 #include <print>
 #include <ranges>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
@@ -32,6 +40,92 @@ struct std::formatter<Coords> : formatter<string_view>
   }
 };
 
+// Read-only memory mapping of a whole file, an unreadable file maps as empty
+class MappedFile
+{
+ public:
+  explicit MappedFile(const string& file_name)
+  {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED)
+      {
+        this->address = addr;
+        this->size    = st.st_size;
+      }
+    }
+    close(fd);
+  }
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile()
+  {
+    if (this->address)
+    {
+      munmap(this->address, this->size);
+    }
+  }
+  string_view view() const
+  {
+    return {static_cast<const char*>(this->address), this->size};
+  }
+
+ private:
+  void*  address = nullptr;
+  size_t size    = 0;
+};
+
+// View of a text grid without copying it. Rows are reached through a stride that skips the
+// newlines, and every cell outside the grid reads as the border character, so read-only
+// solvers can work on the mapped input directly.
+class CharGrid
+{
+ public:
+  explicit CharGrid(string_view buffer, char border_char = '\0')
+      : data(buffer.data()), border(border_char)
+  {
+    const auto newline_pos = buffer.find('\n');
+    this->width            = newline_pos == string_view::npos ? buffer.size() : newline_pos;
+    this->stride           = this->width + 1;
+    // The last line may lack its newline
+    this->height = this->width == 0 ? 0 : (buffer.size() + 1) / this->stride;
+  }
+  char operator[](Coords c) const
+  {
+    if (c.x < 0 || c.y < 0 || c.x >= this->width || c.y >= this->height)
+    {
+      return this->border;
+    }
+    return this->data[c.y * this->stride + c.x];
+  }
+  const char* row(int y) const
+  {
+    return this->data + y * this->stride;
+  }
+  int get_height() const
+  {
+    return this->height;
+  };
+  int get_width() const
+  {
+    return this->width;
+  };
+
+ private:
+  const char* data   = nullptr;
+  char        border = '\0';
+  int         width  = 0;
+  int         height = 0;
+  int         stride = 1;
+};
+
 template <typename T>
 class Map;
 
@@ -74,7 +168,13 @@ class Map
       ++this->height;
       insert_border_row();
     }
-    this->data.reserve(this->width * this->width);
+    error_code ec;
+    const auto file_size = filesystem::file_size(file_name, ec);
+    if (!ec)
+    {
+      // Every line but possibly the last one is followed by a newline
+      this->data.reserve(this->width * (file_size / (str.size() + 1) + 3));
+    }
     insert_data_row(str);
     // Read the rest of the lines
     while (getline(file, str))
@@ -88,17 +188,36 @@ class Map
       ++this->height;
       insert_border_row();
     }
-    if (this->border)
-    {
-      this->coords_begin_indices = {1, 1};
-      this->coords_end_indices   = {this->width - 1, this->height - 1};
-    }
-    else
-    {
-      this->coords_begin_indices = {0, 0};
-      this->coords_end_indices   = {this->width, this->height};
-    }
+    set_coords_indices();
   };
+  template <typename Parser>
+  Map(const CharGrid& grid, Parser item_parser, optional<T> border_opt = nullopt)
+      : border(border_opt)
+  {
+    fill(grid,
+         [&item_parser](const char* src, T* dst, int n)
+         {
+           for (int i = 0; i < n; ++i)
+           {
+             dst[i] = item_parser(src[i]);
+           }
+         });
+  }
+  // Byte map fast path for Map<uint8_t>, cells equal to match become 1 and all others 0. The
+  // branchless compare loop is vectorised by the compiler, one row in a few wide instructions.
+  Map(const CharGrid& grid, char match, optional<T> border_opt = nullopt)
+    requires is_same_v<T, uint8_t>
+      : border(border_opt)
+  {
+    fill(grid,
+         [match](const char* src, T* dst, int n) noexcept
+         {
+           for (int i = 0; i < n; ++i)
+           {
+             dst[i] = static_cast<T>(src[i] == match);
+           }
+         });
+  }
   template <typename U>
   U fold(U start_value, const function<U(U, Coords)> folding_function)
   {
@@ -148,6 +267,32 @@ class Map
   };
 
  private:
+  template <typename RowConverter>
+  void fill(const CharGrid& grid, RowConverter convert_row)
+  {
+    const int offset = this->border ? 1 : 0;
+    this->width      = grid.get_width() + 2 * offset;
+    this->height     = grid.get_height() + 2 * offset;
+    this->data.assign(this->width * this->height, this->border.value_or(T{}));
+    for (int y = 0; y < grid.get_height(); ++y)
+    {
+      convert_row(grid.row(y), &this->data[(y + offset) * this->width + offset], grid.get_width());
+    }
+    set_coords_indices();
+  }
+  void set_coords_indices()
+  {
+    if (this->border)
+    {
+      this->coords_begin_indices = {1, 1};
+      this->coords_end_indices   = {this->width - 1, this->height - 1};
+    }
+    else
+    {
+      this->coords_begin_indices = {0, 0};
+      this->coords_end_indices   = {this->width, this->height};
+    }
+  }
   int         width                = 0;
   int         height               = 0;
   Coords      coords_begin_indices = {.x = 0, .y = 0};
@@ -184,30 +329,27 @@ struct formatter<Map<T>> : formatter<string_view>
   }
 };
 
+// Only reads the grid, so it runs on the mapped input without converting it
 int64_t solve1(const string& file_name)
 {
-  const auto item_parser = [](char c) noexcept
-  {
-    switch (c)
-    {
-      case '@':
-        return 1;
-      default:
-        return 0;
-    }
-  };
-  Map<int>   map(file_name, item_parser, optional<char>(0));
-  auto const count_neighbours = [&map](int accessible, Coords center) -> int
+  const MappedFile input(file_name);
+  const CharGrid   grid(input.view());
+  int              accessible = 0;
+  for (Coords center; center.y < grid.get_height(); ++center.y)
   {
-    if (map[center] == 1)
+    for (center.x = 0; center.x < grid.get_width(); ++center.x)
     {
+      if (grid[center] != '@')
+      {
+        continue;
+      }
       int    sum = 0;
       Coords c;
       for (c.x = center.x - 1; c.x <= center.x + 1; ++c.x)
       {
         for (c.y = center.y - 1; c.y <= center.y + 1; ++c.y)
         {
-          sum += map[c];
+          sum += grid[c] == '@';
         }
       }
       if (sum < 5)
@@ -215,60 +357,151 @@ int64_t solve1(const string& file_name)
         ++accessible;
       }
     }
-    return accessible;
-  };
-  int accessible = map.fold<int>(0, count_neighbours);
+  }
   return accessible;
 }
 
-int64_t solve2(const string& file_name)
+struct MooreNeighbourhood
 {
-  const auto item_parser = [](char c) noexcept
+  static constexpr array<Coords, 8> offsets = {
+      Coords{-1, -1},
+      Coords{0, -1},
+      Coords{1, -1},
+      Coords{-1, 0},
+      Coords{1, 0},
+      Coords{-1, 1},
+      Coords{0, 1},
+      Coords{1, 1},
+  };
+};
+
+struct VonNeumannNeighbourhood
+{
+  static constexpr array<Coords, 4> offsets = {
+      Coords{0, -1},
+      Coords{-1, 0},
+      Coords{1, 0},
+      Coords{0, 1},
+  };
+};
+
+// Occupied cells (1) with fewer than Threshold occupied neighbours are emptied
+template <typename Neighbourhood, int Threshold>
+struct RemoveIfFewerNeighbours
+{
+  using neighbourhood = Neighbourhood;
+  template <typename T>
+  static T next(const Map<T>& map, Coords center) noexcept
   {
-    switch (c)
+    if (map[center] != 1)
     {
-      case '@':
-        return 1;
-      default:
-        return 0;
+      return map[center];
     }
-  };
-  Map<int>       map(file_name, item_parser, optional<char>(0));
-  vector<Coords> removable;
-  auto const     count_neighbours = [&map, &removable](Coords center)
+    int sum = 0;
+    for (const auto offset : Neighbourhood::offsets)
+    {
+      sum += map[{center.x + offset.x, center.y + offset.y}];
+    }
+    return sum < Threshold ? 0 : 1;
+  }
+};
+
+// Synchronous cellular automaton on a Map. Generations are computed from one buffer into the
+// other, and only cells next to a change in the previous generation are re-evaluated. The map
+// must have a border at least as wide as the rule's neighbourhood.
+template <typename T, typename Rule>
+class Automaton
+{
+ public:
+  explicit Automaton(const Map<T>& map)
+      : buffers{map, map}, is_active(map.get_width() * map.get_height(), false)
   {
-    if (map[center] == 1)
+    const auto begin = map.get_coords_begin_indices();
+    const auto end   = map.get_coords_end_indices();
+    for (Coords c = begin; c.y < end.y; ++c.y)
     {
-      int    sum = 0;
-      Coords c;
-      for (c.x = center.x - 1; c.x <= center.x + 1; ++c.x)
+      for (c.x = begin.x; c.x < end.x; ++c.x)
       {
-        for (c.y = center.y - 1; c.y <= center.y + 1; ++c.y)
-        {
-          sum += map[c];
-        }
+        activate(c);
       }
-      if (sum < 5)
+    }
+  }
+  // Advances one generation and returns the number of cells that changed
+  int step()
+  {
+    const Map<T>& front = this->buffers[this->current];
+    Map<T>&       back  = this->buffers[1 - this->current];
+    this->changed.clear();
+    for (const auto c : this->active)
+    {
+      this->is_active[index(c)] = false;
+      const T value             = Rule::next(front, c);
+      if (value != front[c])
       {
-        removable.push_back(center);
+        back[c] = value;
+        this->changed.push_back(c);
       }
     }
-  };
-  int total_removed = 0;
-  int removed;
-  do
+    this->active.clear();
+    this->current = 1 - this->current;
+    // Bring the now stale buffer up to date and wake up the surroundings of every change
+    for (const auto c : this->changed)
+    {
+      this->buffers[1 - this->current][c] = this->buffers[this->current][c];
+      activate(c);
+      for (const auto offset : Rule::neighbourhood::offsets)
+      {
+        activate({c.x + offset.x, c.y + offset.y});
+      }
+    }
+    return this->changed.size();
+  }
+  // Steps until nothing changes and returns the number of changes of every generation
+  vector<int> run_until_fixpoint()
+  {
+    vector<int> changes_per_generation;
+    for (int changes = step(); changes > 0; changes = step())
+    {
+      changes_per_generation.push_back(changes);
+    }
+    return changes_per_generation;
+  }
+  const Map<T>& get_map() const
+  {
+    return this->buffers[this->current];
+  }
+
+ private:
+  int index(Coords c) const
+  {
+    return c.y * this->buffers[0].get_width() + c.x;
+  }
+  void activate(Coords c)
   {
-    removable.clear();
-    map.for_each(count_neighbours);
-    removed = removable.size();
-    for (const auto c : removable)
+    const auto begin = this->buffers[0].get_coords_begin_indices();
+    const auto end   = this->buffers[0].get_coords_end_indices();
+    if (c.x < begin.x || c.y < begin.y || c.x >= end.x || c.y >= end.y ||
+        this->is_active[index(c)])
     {
-      map[c] = 0;
+      return;
     }
-    total_removed += removed;
-  } while (removed > 0);
+    this->is_active[index(c)] = true;
+    this->active.push_back(c);
+  }
+  Map<T>         buffers[2];
+  int            current = 0;
+  vector<bool>   is_active;
+  vector<Coords> active;
+  vector<Coords> changed;
+};
+
+int64_t solve2(const string& file_name)
+{
+  const MappedFile input(file_name);
+  Map<uint8_t>     map(CharGrid(input.view()), '@', optional<uint8_t>(0));
 
-  return total_removed;
+  Automaton<uint8_t, RemoveIfFewerNeighbours<MooreNeighbourhood, 4>> automaton(map);
+  return ranges::fold_left(automaton.run_until_fixpoint(), 0, plus<int>{});
 }
 
 int main()
@@ -1,16 +1,26 @@
 #include <algorithm>
+#include <array>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <fstream>
 #include <iterator>
+#include <map>
+#include <numeric>
 #include <print>
 #include <ranges>
 #include <regex>
+#include <span>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 using namespace std;
 using chrono::duration_cast;
 using chrono::high_resolution_clock;
@@ -41,69 +51,363 @@ void read_file(const string&                   file_name,
   }
 }
 
-int64_t solve1(const string& file_name)
+// Sweeps sorted intervals into non-overlapping ones, adjacent intervals are joined
+vector<pair<int64_t, int64_t>> sweep_sorted_intervals(span<const pair<int64_t, int64_t>> intervals)
 {
-  vector<pair<int64_t, int64_t>> intervals;
-  vector<int64_t>                ids;
-  read_file(file_name, intervals, optional(&ids));
-  return ranges::count_if(ids,
-                          [&intervals](auto id) noexcept
-                          {
-                            for (const auto& interval : intervals)
-                            {
-                              if (interval.first <= id && id <= interval.second)
-                              {
-                                return true;
-                              }
-                            }
-                            return false;
-                          });
+  vector<pair<int64_t, int64_t>> non_overlaping_intervals;
+  for (const auto& interval : intervals)
+  {
+    if (!non_overlaping_intervals.empty() &&
+        interval.first <= non_overlaping_intervals.back().second + 1)
+    {
+      non_overlaping_intervals.back().second =
+          max(non_overlaping_intervals.back().second, interval.second);
+      continue;
+    }
+    non_overlaping_intervals.push_back(interval);
+  }
+  return non_overlaping_intervals;
 }
 
 vector<pair<int64_t, int64_t>> combine_intervals(vector<pair<int64_t, int64_t>>& intervals)
 {
-  vector<pair<int64_t, int64_t>> non_overlaping_intervals;
-  while (intervals.size() > 0)
+  ranges::sort(intervals);
+  return sweep_sorted_intervals(intervals);
+}
+
+// Every thread sorts and sweeps its own chunk. The per-chunk results are then merged pairwise,
+// also in parallel, and swept once more.
+vector<pair<int64_t, int64_t>> combine_intervals_parallel(
+    vector<pair<int64_t, int64_t>>& intervals,
+    size_t                          num_threads = thread::hardware_concurrency())
+{
+  const size_t MIN_CHUNK_SIZE = 1 << 16;
+  num_threads                 = min(num_threads, intervals.size() / MIN_CHUNK_SIZE);
+  if (num_threads <= 1)
   {
-    auto interval1 = intervals.back();
-    intervals.pop_back();
-    bool add = true;
-    for (const auto& interval2 : non_overlaping_intervals)
+    return combine_intervals(intervals);
+  }
+  vector<vector<pair<int64_t, int64_t>>> chunk_results(num_threads);
+  {
+    vector<jthread> threads;
+    for (size_t t = 0; t < num_threads; ++t)
     {
-      if (interval1.second < interval2.first || interval1.first > interval2.second)
+      threads.emplace_back(
+          [&intervals, &chunk_results, num_threads, t]()
+          {
+            const auto first = intervals.begin() + intervals.size() * t / num_threads;
+            const auto last  = intervals.begin() + intervals.size() * (t + 1) / num_threads;
+            sort(first, last);
+            chunk_results[t] = sweep_sorted_intervals({first, last});
+          });
+    }
+  }
+  intervals.clear();
+  vector<size_t> run_begins;
+  for (const auto& chunk_result : chunk_results)
+  {
+    run_begins.push_back(intervals.size());
+    intervals.insert_range(intervals.end(), chunk_result);
+  }
+  run_begins.push_back(intervals.size());
+  while (run_begins.size() > 2)
+  {
+    vector<size_t> merged_run_begins;
+    {
+      vector<jthread> threads;
+      for (size_t run = 0; run + 2 < run_begins.size(); run += 2)
       {
-        // No overlap
-        continue;
+        threads.emplace_back(
+            [&intervals, first = run_begins[run], middle = run_begins[run + 1],
+             last = run_begins[run + 2]]()
+            {
+              inplace_merge(intervals.begin() + first,
+                            intervals.begin() + middle,
+                            intervals.begin() + last);
+            });
+        merged_run_begins.push_back(run_begins[run]);
       }
-      bool beginning_inside =
-          interval1.first >= interval2.first && interval1.first <= interval2.second;
-      bool end_inside = interval1.second >= interval2.first && interval1.second <= interval2.second;
-      if (beginning_inside && end_inside)
+      if (run_begins.size() % 2 == 0)
       {
-        // Interval 1 is fully enclosed by interval 2
-        add = false;
-        break;
+        // Odd number of runs, the last one waits for the next round
+        merged_run_begins.push_back(run_begins[run_begins.size() - 2]);
+      }
+    }
+    merged_run_begins.push_back(run_begins.back());
+    run_begins = move(merged_run_begins);
+  }
+  return sweep_sorted_intervals(intervals);
+}
+
+// Sorted, disjoint intervals stored as flat arrays of begins and ends. Membership is a
+// branchless binary search over the begins followed by a single compare against the end.
+class IntervalIndex
+{
+ public:
+  explicit IntervalIndex(vector<pair<int64_t, int64_t>> intervals)
+  {
+    for (const auto& [interval_begin, interval_end] : combine_intervals(intervals))
+    {
+      this->begins.push_back(interval_begin);
+      this->ends.push_back(interval_end);
+    }
+  }
+  bool contains(int64_t id) const noexcept
+  {
+    if (this->begins.empty())
+    {
+      return false;
+    }
+    // Find the last interval beginning at or before id, the first one if there is none
+    const int64_t* base = this->begins.data();
+    size_t         n    = this->begins.size();
+    while (n > 1)
+    {
+      const size_t half = n / 2;
+      base              = base[half] <= id ? base + half : base;
+      n -= half;
+    }
+    return *base <= id && id <= this->ends[base - this->begins.data()];
+  }
+  size_t size() const noexcept
+  {
+    return this->begins.size();
+  }
+  span<const int64_t> get_begins() const noexcept
+  {
+    return this->begins;
+  }
+  span<const int64_t> get_ends() const noexcept
+  {
+    return this->ends;
+  }
+
+ private:
+  vector<int64_t> begins;
+  vector<int64_t> ends;
+};
+
+// LSD radix sort on 8 bit digits. Returns the ids in ascending order together with the
+// original position of every sorted id. Digits shared by all ids are skipped.
+pair<vector<int64_t>, vector<uint32_t>> radix_sort(const vector<int64_t>& ids)
+{
+  const uint64_t   SIGN_BIT = uint64_t{1} << 63;
+  vector<uint64_t> keys(ids.size());
+  vector<uint32_t> order(ids.size());
+  for (size_t i = 0; i < ids.size(); ++i)
+  {
+    // Flipping the sign bit makes unsigned order match signed order
+    keys[i]  = static_cast<uint64_t>(ids[i]) ^ SIGN_BIT;
+    order[i] = i;
+  }
+  vector<uint64_t> keys_buffer(ids.size());
+  vector<uint32_t> order_buffer(ids.size());
+  for (int shift = 0; shift < 64; shift += 8)
+  {
+    array<size_t, 257> offsets{};
+    for (const auto key : keys)
+    {
+      ++offsets[((key >> shift) & 0xff) + 1];
+    }
+    if (ranges::contains(offsets, ids.size()))
+    {
+      continue;
+    }
+    partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+      const auto pos    = offsets[(keys[i] >> shift) & 0xff]++;
+      keys_buffer[pos]  = keys[i];
+      order_buffer[pos] = order[i];
+    }
+    swap(keys, keys_buffer);
+    swap(order, order_buffer);
+  }
+  vector<int64_t> sorted_ids(ids.size());
+  for (size_t i = 0; i < keys.size(); ++i)
+  {
+    sorted_ids[i] = static_cast<int64_t>(keys[i] ^ SIGN_BIT);
+  }
+  return {move(sorted_ids), move(order)};
+}
+
+struct Classification
+{
+  vector<uint8_t> fresh;  // In the order the ids were given
+  int64_t         count = 0;
+};
+
+const size_t ID_LANES = 8;
+
+// Bit masks over ID_LANES sorted ids: lanes inside the interval, and lanes not beyond its end
+struct LaneMasks
+{
+  uint32_t fresh      = 0;
+  uint32_t not_beyond = 0;
+};
+
+// With AVX2 every compare tests four ids at once and movemask packs the results into bits
+LaneMasks compare_lanes(const int64_t* ids, int64_t interval_begin, int64_t interval_end)
+{
+  uint32_t before = 0;
+  uint32_t beyond = 0;
+#ifdef __AVX2__
+  const __m256i begin_lanes = _mm256_set1_epi64x(interval_begin);
+  const __m256i end_lanes   = _mm256_set1_epi64x(interval_end);
+  for (size_t lane = 0; lane < ID_LANES; lane += 4)
+  {
+    const __m256i id_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ids + lane));
+    const auto    is_before =
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(begin_lanes, id_lanes)));
+    const auto is_beyond =
+        _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(id_lanes, end_lanes)));
+    before |= static_cast<uint32_t>(is_before) << lane;
+    beyond |= static_cast<uint32_t>(is_beyond) << lane;
+  }
+#else
+  for (size_t lane = 0; lane < ID_LANES; ++lane)
+  {
+    before |= static_cast<uint32_t>(ids[lane] < interval_begin) << lane;
+    beyond |= static_cast<uint32_t>(ids[lane] > interval_end) << lane;
+  }
+#endif
+  const uint32_t all_lanes = (1u << ID_LANES) - 1;
+  return {~(before | beyond) & all_lanes, ~beyond & all_lanes};
+}
+
+// Sorts the ids and merge-joins them against the disjoint intervals in a single pass. Ids are
+// tested against the current interval ID_LANES at a time through compare_lanes. Since the ids
+// are sorted, the ones not beyond the interval's end form a prefix of the block and are final,
+// the rest are tested again.
+Classification classify_ids(const IntervalIndex& index, const vector<int64_t>& ids)
+{
+  const auto [sorted_ids, order] = radix_sort(ids);
+
+  const auto      begins = index.get_begins();
+  const auto      ends   = index.get_ends();
+  vector<uint8_t> sorted_fresh(ids.size(), 0);
+  size_t          i = 0;
+  for (size_t k = 0; k < begins.size() && i < sorted_ids.size(); ++k)
+  {
+    const int64_t interval_begin = begins[k];
+    const int64_t interval_end   = ends[k];
+    while (i + ID_LANES <= sorted_ids.size())
+    {
+      const auto masks = compare_lanes(&sorted_ids[i], interval_begin, interval_end);
+      for (size_t lane = 0; lane < ID_LANES; ++lane)
+      {
+        sorted_fresh[i + lane] = (masks.fresh >> lane) & 1;
       }
-      if (beginning_inside)
+      const auto not_beyond = static_cast<size_t>(popcount(masks.not_beyond));
+      i += not_beyond;
+      if (not_beyond < ID_LANES)
       {
-        interval1.first = interval2.second + 1;
-        continue;
+        break;
       }
-      else if (end_inside)
+    }
+    if (i + ID_LANES > sorted_ids.size())
+    {
+      for (; i < sorted_ids.size() && sorted_ids[i] <= interval_end; ++i)
       {
-        interval1.second = interval2.first - 1;
-        continue;
+        sorted_fresh[i] = sorted_ids[i] >= interval_begin;
       }
-      // Interval 1 is fully enclosing interval 2
-      intervals.push_back({interval2.second + 1, interval1.second});
-      interval1.second = interval2.first - 1;
     }
-    if (add)
+  }
+  // Whatever is left lies beyond the last interval
+  fill(sorted_fresh.begin() + i, sorted_fresh.end(), 0);
+  Classification classification{vector<uint8_t>(ids.size()), 0};
+  for (size_t j = 0; j < sorted_ids.size(); ++j)
+  {
+    classification.fresh[order[j]] = sorted_fresh[j];
+    classification.count += sorted_fresh[j];
+  }
+  return classification;
+}
+
+// Disjoint intervals keyed on their begins. Insertions and erasures only visit the intervals
+// they touch, and the number of covered ids is kept up to date along the way.
+class IntervalSet
+{
+ public:
+  void insert(int64_t interval_begin, int64_t interval_end)
+  {
+    auto iter = this->intervals.upper_bound(interval_begin);
+    if (iter != this->intervals.begin() && prev(iter)->second + 1 >= interval_begin)
+    {
+      --iter;
+    }
+    // Absorb every overlapping or adjacent interval
+    while (iter != this->intervals.end() && iter->first <= interval_end + 1)
     {
-      non_overlaping_intervals.push_back(interval1);
+      interval_begin = min(interval_begin, iter->first);
+      interval_end   = max(interval_end, iter->second);
+      this->covered -= iter->second - iter->first + 1;
+      iter = this->intervals.erase(iter);
     }
+    this->intervals.emplace_hint(iter, interval_begin, interval_end);
+    this->covered += interval_end - interval_begin + 1;
   }
-  return non_overlaping_intervals;
+  void erase(int64_t interval_begin, int64_t interval_end)
+  {
+    auto iter = this->intervals.upper_bound(interval_begin);
+    if (iter != this->intervals.begin() && prev(iter)->second >= interval_begin)
+    {
+      --iter;
+    }
+    while (iter != this->intervals.end() && iter->first <= interval_end)
+    {
+      const auto [old_begin, old_end] = *iter;
+      this->covered -= old_end - old_begin + 1;
+      iter = this->intervals.erase(iter);
+      // Keep whatever sticks out on either side
+      if (old_begin < interval_begin)
+      {
+        this->intervals.emplace_hint(iter, old_begin, interval_begin - 1);
+        this->covered += interval_begin - old_begin;
+      }
+      if (old_end > interval_end)
+      {
+        this->intervals.emplace_hint(iter, interval_end + 1, old_end);
+        this->covered += old_end - interval_end;
+      }
+    }
+  }
+  bool contains(int64_t id) const
+  {
+    const auto iter = this->intervals.upper_bound(id);
+    return iter != this->intervals.begin() && prev(iter)->second >= id;
+  }
+  int64_t covered_count() const noexcept
+  {
+    return this->covered;
+  }
+  size_t size() const noexcept
+  {
+    return this->intervals.size();
+  }
+
+ private:
+  map<int64_t, int64_t> intervals;
+  int64_t               covered = 0;
+};
+
+int64_t solve1(const string& file_name)
+{
+  vector<pair<int64_t, int64_t>> intervals;
+  vector<int64_t>                ids;
+  read_file(file_name, intervals, optional(&ids));
+  const IntervalIndex index(move(intervals));
+  return classify_ids(index, ids).count;
+}
+
+// Part 1 through one branchless membership lookup per id, in the order the ids were given
+int64_t solve1_lookup(const string& file_name)
+{
+  vector<pair<int64_t, int64_t>> intervals;
+  vector<int64_t>                ids;
+  read_file(file_name, intervals, optional(&ids));
+  const IntervalIndex index(move(intervals));
+  return ranges::count_if(ids, [&index](int64_t id) { return index.contains(id); });
 }
 
 int64_t solve2(const string& file_name)
@@ -111,13 +415,64 @@ int64_t solve2(const string& file_name)
   vector<pair<int64_t, int64_t>> intervals;
   read_file(file_name, intervals);
   return ranges::fold_left_first(
-             combine_intervals(intervals) |
+             combine_intervals_parallel(intervals) |
                  ranges::views::transform([](const auto& interval) noexcept
                                           { return interval.second - interval.first + 1; }),
              plus<int64_t>{})
       .value();
 }
 
+int64_t solve2_incremental(const string& file_name)
+{
+  vector<pair<int64_t, int64_t>> intervals;
+  read_file(file_name, intervals);
+  IntervalSet interval_set;
+  for (const auto& [interval_begin, interval_end] : intervals)
+  {
+    interval_set.insert(interval_begin, interval_end);
+  }
+  return interval_set.covered_count();
+}
+
+// Inserts every range, erases the first half again and inserts the second half once more, which
+// must leave exactly the second half covered. Checks the covered count against the second half
+// combined on its own, and membership of the ids and of the ids around every range end.
+bool check_incremental_erase(const string& file_name)
+{
+  vector<pair<int64_t, int64_t>> intervals;
+  vector<int64_t>                ids;
+  read_file(file_name, intervals, optional(&ids));
+  const auto  half = intervals.size() / 2;
+  IntervalSet interval_set;
+  for (const auto& [interval_begin, interval_end] : intervals)
+  {
+    interval_set.insert(interval_begin, interval_end);
+  }
+  for (const auto& [interval_begin, interval_end] : intervals | ranges::views::take(half))
+  {
+    interval_set.erase(interval_begin, interval_end);
+  }
+  for (const auto& [interval_begin, interval_end] : intervals | ranges::views::drop(half))
+  {
+    interval_set.insert(interval_begin, interval_end);
+  }
+  vector<pair<int64_t, int64_t>> remaining(intervals.begin() + half, intervals.end());
+  int64_t                        covered = 0;
+  for (const auto& [interval_begin, interval_end] : combine_intervals(remaining))
+  {
+    covered += interval_end - interval_begin + 1;
+  }
+  for (const auto& [interval_begin, interval_end] : intervals)
+  {
+    ids.insert(ids.end(), {interval_begin - 1, interval_begin, interval_end, interval_end + 1});
+  }
+  const IntervalIndex index(remaining);
+  return interval_set.covered_count() == covered &&
+         ranges::all_of(ids,
+                        [&interval_set, &index](int64_t id)
+                        { return interval_set.contains(id) == index.contains(id); });
+}
+
 int main()
 {
   const string  INPUT_FILE{"day05.inp"};
@@ -134,6 +489,8 @@ int main()
   println("Answer  part 1: {} ({})", part1, duration_cast<microseconds>(duration1));
   const int64_t CORRECT_ANSWER_PART_1 = 885;
   assert(part1 == CORRECT_ANSWER_PART_1);
+  assert(solve1_lookup(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_1);
+  assert(solve1_lookup(INPUT_FILE) == CORRECT_ANSWER_PART_1);
 
   const int64_t example2 = solve2(EXAMPLE_FILE);
   println("Example part 2: {}", example2);
@@ -146,4 +503,9 @@ int main()
   println("Answer  part 2: {} ({})", part2, duration_cast<microseconds>(duration2));
   const int64_t CORRECT_ANSWER_PART2 = 348115621205535;
   assert(part2 == CORRECT_ANSWER_PART2);
+
+  assert(solve2_incremental(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+  assert(solve2_incremental(INPUT_FILE) == CORRECT_ANSWER_PART2);
+  assert(check_incremental_erase(EXAMPLE_FILE));
+  assert(check_incremental_erase(INPUT_FILE));
 };
\ No newline at end of file
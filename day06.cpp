@@ -1,5 +1,14 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cctype>
 #include <chrono>
 #include <cmath>
 #include <fstream>
@@ -7,8 +16,12 @@
 #include <print>
 #include <ranges>
 #include <regex>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 using namespace std;
@@ -16,100 +29,370 @@ using chrono::duration_cast;
 using chrono::high_resolution_clock;
 using chrono::microseconds;
 
-int64_t read_file1(const string& file_name)
+// Numbers stored row after row with num_problems numbers per row, so that every row is one
+// contiguous array. Bit p of the multiply mask is set when problem p is a product.
+struct Worksheet
+{
+  size_t           num_problems = 0;
+  size_t           num_rows     = 0;
+  vector<int64_t>  numbers;
+  vector<uint64_t> multiply_mask;
+};
+
+__extension__ using WideInt = __int128;
+
+// Plain multiplication, except for WideInt where overflowing 128 bits throws instead of wrapping
+template <typename T>
+T checked_multiply(T a, int64_t b)
 {
-  ifstream                file(file_name);
-  string                  str;
-  vector<vector<int64_t>> number_rows;
-  vector<char>            ops;
-  while (getline(file, str))
+  if constexpr (is_same_v<T, WideInt>)
   {
-    stringstream ss(move(str));
-    file.peek();
-    if (file.eof())
+    T product;
+    if (__builtin_mul_overflow(a, b, &product))
     {
-      const istream_iterator<char> ops_iter(ss);
-      ops.insert(ops.end(), ops_iter, istream_iterator<char>{});
+      throw overflow_error("Worksheet product does not fit in 128 bits");
     }
-    else
+    return product;
+  }
+  else
+  {
+    return a * b;
+  }
+}
+
+// Every row contributes to the sums and the products of the whole block in one contiguous loop
+// that the compiler vectorises for 64 bit lanes, and the operator mask then picks sum or
+// product per problem.
+template <typename Lane, size_t BLOCK_SIZE, typename Accumulator>
+void reduce_block(const Worksheet& worksheet, size_t first, size_t n, Accumulator& result)
+{
+  array<Lane, BLOCK_SIZE> sums{};
+  array<Lane, BLOCK_SIZE> products;
+  products.fill(1);
+  for (size_t row = 0; row < worksheet.num_rows; ++row)
+  {
+    const int64_t* numbers = &worksheet.numbers[row * worksheet.num_problems + first];
+    for (size_t i = 0; i < n; ++i)
     {
-      number_rows.push_back({});
-      const istream_iterator<int64_t> iter(ss);
-      number_rows.back().insert(number_rows.back().end(), iter, istream_iterator<int64_t>());
+      sums[i] += numbers[i];
+      products[i] = checked_multiply(products[i], numbers[i]);
     }
   }
-  int64_t         result = 0;
-  vector<int64_t> number_col;
-  for (size_t col = 0; col < ops.size(); ++col)
+  const uint64_t mask = worksheet.multiply_mask[first / BLOCK_SIZE];
+  for (size_t i = 0; i < n; ++i)
+  {
+    result += (mask >> i) & 1 ? products[i] : sums[i];
+  }
+}
+
+// Reduces a block of problems at a time. With a WideInt accumulator a block still runs in
+// 64 bit lanes when the bit widths of its largest numbers prove that nothing can overflow,
+// and only falls back to WideInt lanes otherwise.
+template <typename Accumulator = int64_t>
+Accumulator evaluate_rows(const Worksheet& worksheet)
+{
+  const size_t BLOCK_SIZE = 64;
+  Accumulator  result     = 0;
+  for (size_t first = 0; first < worksheet.num_problems; first += BLOCK_SIZE)
   {
-    number_col.clear();
-    for (size_t row = 0; row < number_rows.size(); ++row)
+    const size_t n    = min(BLOCK_SIZE, worksheet.num_problems - first);
+    bool         fits = true;
+    if constexpr (is_same_v<Accumulator, WideInt>)
     {
-      number_col.push_back(number_rows[row][col]);
+      int      product_bits = 0;
+      uint64_t largest      = 0;
+      for (size_t row = 0; row < worksheet.num_rows; ++row)
+      {
+        const int64_t* numbers = &worksheet.numbers[row * worksheet.num_problems + first];
+        uint64_t       row_max = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+          row_max = max(row_max, static_cast<uint64_t>(numbers[i]));
+        }
+        product_bits += bit_width(row_max);
+        largest = max(largest, row_max);
+      }
+      const int sum_bits = bit_width(largest) + bit_width(worksheet.num_rows);
+      fits               = product_bits <= 62 && sum_bits <= 62;
     }
-    if (ops[col] == '+')
+    if (fits)
     {
-      result += ranges::fold_left_first(number_col, plus<int64_t>{}).value();
+      reduce_block<int64_t, BLOCK_SIZE>(worksheet, first, n, result);
     }
     else
     {
-      result += ranges::fold_left_first(number_col, multiplies<int64_t>{}).value();
+      reduce_block<Accumulator, BLOCK_SIZE>(worksheet, first, n, result);
     }
   }
   return result;
 }
 
-int64_t read_file2(const string& file_name)
+// Read-only memory mapping of a whole file, an unreadable file maps as empty
+class MappedFile
 {
-  ifstream       file(file_name);
-  vector<string> lines;
-  string         str;
-  while (getline(file, str))
+ public:
+  explicit MappedFile(const string& file_name)
+  {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED)
+      {
+        this->address = addr;
+        this->size    = st.st_size;
+      }
+    }
+    close(fd);
+  }
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile()
+  {
+    if (this->address)
+    {
+      munmap(this->address, this->size);
+    }
+  }
+  string_view view() const
   {
-    lines.emplace_back(str);
+    return {static_cast<const char*>(this->address), this->size};
   }
 
-  const int       num_col = lines.front().size();
-  const int       num_row = lines.size();
-  int64_t         result  = 0;
-  vector<int64_t> numbers;
-  str.clear();
-  for (int col = num_col - 1; col >= 0; --col)
+ private:
+  void*  address = nullptr;
+  size_t size    = 0;
+};
+
+// Mapped worksheet seen as a grid of equally long lines, the last one holding the operators
+class WorksheetGrid
+{
+ public:
+  explicit WorksheetGrid(string_view buffer)
+      : data(buffer.data())
   {
-    for (int row = 0; row < num_row - 1; ++row)
+    const auto newline_pos = buffer.find('\n');
+    if (newline_pos == string_view::npos)
     {
-      str.push_back(lines[row][col]);
+      return;
     }
-    numbers.push_back(stoll(str));
-    str.clear();
-    char op = lines.back()[col];
-    switch (op)
+    this->width  = newline_pos;
+    this->stride = this->width + 1;
+    // The operator line may lack its newline and trailing spaces
+    if (buffer.ends_with('\n'))
     {
-      default:
-        break;
-      case '+':
-        result += ranges::fold_left_first(numbers, plus<int64_t>{}).value();
-        numbers.clear();
-        --col;
-        break;
-      case '*':
-        result += ranges::fold_left_first(numbers, multiplies<int64_t>{}).value();
-        numbers.clear();
-        --col;
-        break;
+      buffer.remove_suffix(1);
     }
+    const auto ops_begin = buffer.rfind('\n') + 1;
+    this->num_rows       = ops_begin / this->stride;
+    this->ops            = this->data + ops_begin;
+    this->ops_length     = min(this->width, buffer.size() - ops_begin);
+  }
+  const char* row(size_t r) const
+  {
+    return this->data + r * this->stride;
+  }
+  char op(size_t col) const
+  {
+    return col < this->ops_length ? this->ops[col] : ' ';
+  }
+  size_t get_width() const
+  {
+    return this->width;
+  }
+  size_t get_num_rows() const
+  {
+    return this->num_rows;
+  }
+
+ private:
+  const char* data       = nullptr;
+  const char* ops        = nullptr;
+  size_t      width      = 0;
+  size_t      stride     = 1;
+  size_t      num_rows   = 0;
+  size_t      ops_length = 0;
+};
+
+// Part 1 view of the columns [first_col, last_col), which must start with a problem
+Worksheet parse_worksheet(const WorksheetGrid& grid, size_t first_col, size_t last_col)
+{
+  Worksheet worksheet;
+  for (size_t col = first_col; col < last_col; ++col)
+  {
+    const char c = grid.op(col);
+    if (c != '+' && c != '*')
+    {
+      continue;
+    }
+    const auto bit = worksheet.num_problems % 64;
+    if (bit == 0)
+    {
+      worksheet.multiply_mask.push_back(0);
+    }
+    worksheet.multiply_mask.back() |= uint64_t{c == '*'} << bit;
+    ++worksheet.num_problems;
+  }
+  worksheet.num_rows = grid.get_num_rows();
+  worksheet.numbers.reserve(worksheet.num_rows * worksheet.num_problems);
+  for (size_t row = 0; row < grid.get_num_rows(); ++row)
+  {
+    const char* line      = grid.row(row);
+    int64_t     number    = 0;
+    bool        in_number = false;
+    for (size_t col = first_col; col < last_col; ++col)
+    {
+      if (isdigit(line[col]))
+      {
+        number    = number * 10 + (line[col] - '0');
+        in_number = true;
+      }
+      else if (in_number)
+      {
+        worksheet.numbers.push_back(number);
+        number    = 0;
+        in_number = false;
+      }
+    }
+    if (in_number)
+    {
+      worksheet.numbers.push_back(number);
+    }
+  }
+  return worksheet;
+}
+
+// Part 2 semantics over the columns [first_col, last_col), which must start with a problem.
+// Columns are read in tiles: every row contributes one contiguous slice of the tile, and its
+// digits are accumulated straight into the tile's column numbers. A problem starts at the
+// column holding its operator, and blank columns contribute nothing.
+template <typename Accumulator = int64_t>
+Accumulator evaluate_columns(const WorksheetGrid& grid, size_t first_col, size_t last_col)
+{
+  const size_t TILE_WIDTH = 64;
+  Accumulator  result     = 0;
+  Accumulator  value      = 0;
+  bool         is_product = false;
+  for (size_t first = first_col; first < last_col; first += TILE_WIDTH)
+  {
+    const size_t               n = min(TILE_WIDTH, last_col - first);
+    array<int64_t, TILE_WIDTH> numbers{};
+    array<uint8_t, TILE_WIDTH> has_digit{};
+    for (size_t row = 0; row < grid.get_num_rows(); ++row)
+    {
+      const char* line = grid.row(row) + first;
+      for (size_t i = 0; i < n; ++i)
+      {
+        const int  digit    = line[i] - '0';
+        const bool is_digit = static_cast<unsigned>(digit) < 10;
+        numbers[i]          = is_digit ? numbers[i] * 10 + digit : numbers[i];
+        has_digit[i] |= is_digit;
+      }
+    }
+    for (size_t i = 0; i < n; ++i)
+    {
+      const char op = grid.op(first + i);
+      if (op == '+' || op == '*')
+      {
+        result += value;
+        is_product = op == '*';
+        value      = is_product ? 1 : 0;
+      }
+      if (has_digit[i])
+      {
+        value = is_product ? checked_multiply(value, numbers[i]) : value + numbers[i];
+      }
+    }
+  }
+  return result + value;
+}
+
+// The column of every operator, which is where every problem starts
+vector<size_t> problem_starts(const WorksheetGrid& grid)
+{
+  vector<size_t> starts;
+  for (size_t col = 0; col < grid.get_width(); ++col)
+  {
+    const char op = grid.op(col);
+    if (op == '+' || op == '*')
+    {
+      starts.push_back(col);
+    }
+  }
+  return starts;
+}
+
+// Splits the worksheet into blocks of problems that a pool of threads pick up one at a time.
+// Every block is evaluated with both part 1 and part 2 semantics, and the per-thread partial
+// sums are added up at the end.
+pair<int64_t, int64_t> solve_parallel(const string& file_name,
+                                      size_t        num_threads = thread::hardware_concurrency())
+{
+  const size_t        PROBLEMS_PER_BLOCK = 1024;
+  const MappedFile    input(file_name);
+  const WorksheetGrid grid(input.view());
+  const auto          starts     = problem_starts(grid);
+  const size_t        num_blocks = (starts.size() + PROBLEMS_PER_BLOCK - 1) / PROBLEMS_PER_BLOCK;
+  num_threads                    = clamp<size_t>(num_threads, 1, max<size_t>(num_blocks, 1));
+  vector<pair<int64_t, int64_t>> partial_sums(num_threads);
+  atomic<size_t>                 next_block = 0;
+  {
+    vector<jthread> workers;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+      workers.emplace_back(
+          [&, t]()
+          {
+            pair<int64_t, int64_t> sums{0, 0};
+            for (size_t block = next_block++; block < num_blocks; block = next_block++)
+            {
+              const size_t first_problem = block * PROBLEMS_PER_BLOCK;
+              const size_t last_problem  = first_problem + PROBLEMS_PER_BLOCK;
+              const size_t first_col     = starts[first_problem];
+              const size_t last_col =
+                  last_problem < starts.size() ? starts[last_problem] : grid.get_width();
+              sums.first += evaluate_rows(parse_worksheet(grid, first_col, last_col));
+              sums.second += evaluate_columns(grid, first_col, last_col);
+            }
+            partial_sums[t] = sums;
+          });
+    }
+  }
+  pair<int64_t, int64_t> result{0, 0};
+  for (const auto& [sum1, sum2] : partial_sums)
+  {
+    result.first += sum1;
+    result.second += sum2;
   }
   return result;
 }
 
+// Both parts with 128 bit accumulators, for worksheets whose products do not fit in 64 bits
+pair<WideInt, WideInt> solve_wide(const string& file_name)
+{
+  const MappedFile    input(file_name);
+  const WorksheetGrid grid(input.view());
+  return {evaluate_rows<WideInt>(parse_worksheet(grid, 0, grid.get_width())),
+          evaluate_columns<WideInt>(grid, 0, grid.get_width())};
+}
+
 int64_t solve1(const string& file_name)
 {
-  return read_file1(file_name);
+  const MappedFile    input(file_name);
+  const WorksheetGrid grid(input.view());
+  return evaluate_rows(parse_worksheet(grid, 0, grid.get_width()));
 }
 
 int64_t solve2(const string& file_name)
 {
-  return read_file2(file_name);
+  const MappedFile    input(file_name);
+  const WorksheetGrid grid(input.view());
+  return evaluate_columns(grid, 0, grid.get_width());
 }
 
 int main()
@@ -140,4 +423,25 @@ int main()
   println("Answer  part 2: {} ({})", part2, duration_cast<microseconds>(duration2));
   const int64_t CORRECT_ANSWER_PART2 = 9640641878593;
   assert(part2 == CORRECT_ANSWER_PART2);
+
+  const auto [example1_parallel, example2_parallel] = solve_parallel(EXAMPLE_FILE);
+  assert(example1_parallel == CORRECT_ANSWER_EXAMPLE_1);
+  assert(example2_parallel == CORRECT_ANSWER_EXAMPLE_2);
+
+  auto start3                                = chrono::high_resolution_clock::now();
+  const auto [part1_parallel, part2_parallel] = solve_parallel(INPUT_FILE);
+  auto duration3                              = high_resolution_clock::now() - start3;
+  println("Parallel part 1: {}\nParallel part 2: {}\nBoth in: {}",
+          part1_parallel,
+          part2_parallel,
+          duration_cast<microseconds>(duration3));
+  assert(part1_parallel == CORRECT_ANSWER_PART_1);
+  assert(part2_parallel == CORRECT_ANSWER_PART2);
+
+  const auto [example1_wide, example2_wide] = solve_wide(EXAMPLE_FILE);
+  assert(example1_wide == CORRECT_ANSWER_EXAMPLE_1);
+  assert(example2_wide == CORRECT_ANSWER_EXAMPLE_2);
+  const auto [part1_wide, part2_wide] = solve_wide(INPUT_FILE);
+  assert(part1_wide == CORRECT_ANSWER_PART_1);
+  assert(part2_wide == CORRECT_ANSWER_PART2);
 };
\ No newline at end of file
@@ -1,22 +1,74 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <fstream>
-#include <map>
 #include <print>
 #include <ranges>
 #include <regex>
-#include <set>
+#include <span>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
 using namespace std;
 using chrono::duration_cast;
 using chrono::high_resolution_clock;
 using chrono::microseconds;
 
+// Read-only memory mapping of a whole file, an unreadable file maps as empty
+class MappedFile
+{
+ public:
+  explicit MappedFile(const string& file_name)
+  {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED)
+      {
+        this->address = addr;
+        this->size    = st.st_size;
+      }
+    }
+    close(fd);
+  }
+  MappedFile(const MappedFile&)            = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile()
+  {
+    if (this->address)
+    {
+      munmap(this->address, this->size);
+    }
+  }
+  string_view view() const
+  {
+    return {static_cast<const char*>(this->address), this->size};
+  }
+
+ private:
+  void*  address = nullptr;
+  size_t size    = 0;
+};
+
 vector<string> read_file(const string& file_name)
 {
   ifstream       file(file_name);
@@ -29,50 +81,186 @@ vector<string> read_file(const string& file_name)
   return lines;
 }
 
-void update_tachyons(map<int, int64_t>& tachyons, int p, int64_t m)
+// Bit c of the word is set when chars[c] is a splitter, for up to 64 chars. With AVX2 a full
+// word is two byte compares against '^' whose movemasks are the two halves of the word.
+uint64_t splitter_word(const char* chars, size_t count)
+{
+#ifdef __AVX2__
+  if (count == 64)
+  {
+    const __m256i splitter  = _mm256_set1_epi8('^');
+    const __m256i low       = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars));
+    const __m256i high      = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(chars + 32));
+    const auto    low_mask  = _mm256_movemask_epi8(_mm256_cmpeq_epi8(low, splitter));
+    const auto    high_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(high, splitter));
+    return (uint64_t{static_cast<uint32_t>(high_mask)} << 32) | static_cast<uint32_t>(low_mask);
+  }
+#endif
+  uint64_t word = 0;
+  for (size_t col = 0; col < count; ++col)
+  {
+    word |= uint64_t{chars[col] == '^'} << col;
+  }
+  return word;
+}
+
+// Part 1 only needs to know which columns hold a beam, so a row of beams is a bitset. The
+// splitters of a row are turned into words 64 chars at a time by splitter_word, and 64 columns
+// are split at once. Beams sent past the last column are dropped, as in solve2.
+int solve1(const string& file_name)
+{
+  const auto   lines     = read_file(file_name);
+  const size_t width     = lines.front().size();
+  const size_t num_words = (width + 63) / 64;
+  const auto   last_word_mask =
+      width % 64 == 0 ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1;
+  vector<uint64_t> beams(num_words, 0);
+  vector<uint64_t> splitters(num_words, 0);
+  vector<uint64_t> hits(num_words, 0);
+  const size_t     start = lines.front().find('S');
+  beams[start / 64] |= uint64_t{1} << (start % 64);
+  int splits = 0;
+  for (const auto& line : lines)
+  {
+    for (size_t word = 0; word < num_words; ++word)
+    {
+      splitters[word] = splitter_word(line.data() + 64 * word, min<size_t>(64, width - 64 * word));
+    }
+    for (size_t word = 0; word < num_words; ++word)
+    {
+      hits[word] = beams[word] & splitters[word];
+      splits += popcount(hits[word]);
+    }
+    // Split beams move one column left and right, possibly across a word boundary
+    for (size_t word = 0; word < num_words; ++word)
+    {
+      const uint64_t from_left  = (hits[word] << 1) | (word > 0 ? hits[word - 1] >> 63 : 0);
+      const uint64_t from_right =
+          (hits[word] >> 1) | (word + 1 < num_words ? hits[word + 1] << 63 : 0);
+      beams[word] = (beams[word] & ~splitters[word]) | from_left | from_right;
+    }
+    beams.back() &= last_word_mask;
+  }
+  return splits;
+}
+
+// Moves the beams of one row into next_beams and returns the number of splitters hit. A
+// splitter mask makes the update branchless: every column keeps what passes it and receives
+// what the splitters on either side send over, so a row is three shifted loads, masks and adds.
+// All arrays carry one column of padding on each side.
+int split_row(string_view line, const int64_t* beams, int64_t* next_beams, int64_t* splitters)
 {
-  const auto iter = tachyons.find(p);
-  if (iter == tachyons.end())
+  const size_t width = line.size();
+  for (size_t col = 0; col < width; ++col)
   {
-    tachyons[p] = m;
+    splitters[col + 1] = -static_cast<int64_t>(line[col] == '^');
   }
-  else
+  int splits = 0;
+  for (size_t col = 1; col <= width; ++col)
   {
-    tachyons[p] += m;
+    next_beams[col] = (beams[col] & ~splitters[col]) + (beams[col - 1] & splitters[col - 1]) +
+                      (beams[col + 1] & splitters[col + 1]);
+    splits += (beams[col] != 0) & (splitters[col] != 0);
   }
+  return splits;
 }
 
+// Timeline counts per column live in two arrays that trade places every row
 pair<int, int64_t> solve2(const string& file_name)
 {
-  const auto        lines = read_file(file_name);
-  map<int, int64_t> tachyons[2];
-  int               current                  = 0;
-  tachyons[current][lines.front().find('S')] = 1;
-  int splits                                 = 0;
+  const auto   lines = read_file(file_name);
+  const size_t width = lines.front().size();
+
+  vector<int64_t> tachyons[2] = {vector<int64_t>(width + 2, 0), vector<int64_t>(width + 2, 0)};
+  vector<int64_t> splitters(width + 2, 0);
+  int             current                        = 0;
+  tachyons[current][lines.front().find('S') + 1] = 1;
+  int splits                                     = 0;
   for (const auto& line : lines)
   {
-    for (const auto [p, m] : tachyons[current])
+    splits += split_row(
+        line, tachyons[current].data(), tachyons[1 - current].data(), splitters.data());
+    current = 1 - current;
+  }
+  return {splits, ranges::fold_left(tachyons[current], int64_t{0}, plus<int64_t>{})};
+}
+
+// Streams the manifold row by row from the mapped input and keeps nothing but the current
+// beams. A row without splitters leaves the beams as they are, so once the vectorised memchr
+// behind find has seen no '^' the row is skipped. Rows are assumed to be equally long.
+pair<int, int64_t> solve_streaming(const string& file_name)
+{
+  const MappedFile  input(file_name);
+  const string_view buffer = input.view();
+  const size_t      width  = min(buffer.find('\n'), buffer.size());
+  const size_t      stride = width + 1;
+
+  vector<int64_t> tachyons[2] = {vector<int64_t>(width + 2, 0), vector<int64_t>(width + 2, 0)};
+  vector<int64_t> splitters(width + 2, 0);
+  int             current                 = 0;
+  tachyons[current][buffer.find('S') + 1] = 1;
+  int splits                              = 0;
+  for (size_t pos = 0; pos < buffer.size(); pos += stride)
+  {
+    const auto line = buffer.substr(pos, width);
+    if (line.find('^') == string_view::npos)
     {
-      int next = 1 - current;
-      if (line[p] == '^')
-      {
-        ++splits;
-        update_tachyons(tachyons[next], p - 1, m);
-        update_tachyons(tachyons[next], p + 1, m);
-      }
-      else
-      {
-        update_tachyons(tachyons[next], p, m);
-      }
+      continue;
     }
-    tachyons[current].clear();
+    splits += split_row(
+        line, tachyons[current].data(), tachyons[1 - current].data(), splitters.data());
     current = 1 - current;
   }
-  return {
-      splits,
-      ranges::fold_left_first(tachyons[current] | ranges::views::values, plus<int64_t>{}).value()};
+  return {splits, ranges::fold_left(tachyons[current], int64_t{0}, plus<int64_t>{})};
 }
 
+// Number of timelines that reach the bottom for a beam entering any row at any column. The
+// table is filled bottom-up in one pass, after which every start position is a lookup. Beams
+// leaving the manifold sideways are dropped, as in solve2.
+class TimelineTable
+{
+ public:
+  explicit TimelineTable(const vector<string>& lines)
+      : width(lines.front().size()),
+        stride(lines.front().size() + 2),
+        table((lines.size() + 1) * (lines.front().size() + 2), 0)
+  {
+    // Below the last row every column is exactly one timeline
+    fill_n(&this->table[lines.size() * this->stride + 1], this->width, 1);
+    for (size_t row = lines.size(); row-- > 0;)
+    {
+      const auto&    line  = lines[row];
+      const int64_t* below = &this->table[(row + 1) * this->stride];
+      int64_t*       here  = &this->table[row * this->stride];
+      for (size_t col = 1; col <= this->width; ++col)
+      {
+        const int64_t splitter = -static_cast<int64_t>(line[col - 1] == '^');
+        here[col] = (below[col] & ~splitter) + ((below[col - 1] + below[col + 1]) & splitter);
+      }
+    }
+  }
+  int64_t timelines(size_t col, size_t row = 0) const
+  {
+    return this->table[row * this->stride + col + 1];
+  }
+  // Timelines for every start column on the top row
+  vector<int64_t> timelines(span<const size_t> cols) const
+  {
+    vector<int64_t> result;
+    result.reserve(cols.size());
+    for (const auto col : cols)
+    {
+      result.push_back(timelines(col));
+    }
+    return result;
+  }
+
+ private:
+  size_t          width  = 0;
+  size_t          stride = 2;
+  vector<int64_t> table;
+};
+
 int main()
 {
   const string INPUT_FILE{"day07.inp"};
@@ -100,4 +288,41 @@ int main()
 
   const int64_t CORRECT_ANSWER_PART2 = 12472142047197;
   assert(part2 == CORRECT_ANSWER_PART2);
+
+  assert(solve1(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_1);
+
+  auto      start2       = chrono::high_resolution_clock::now();
+  const int part1_bitset = solve1(INPUT_FILE);
+  auto      duration2    = high_resolution_clock::now() - start2;
+  println("Bitset  part 1: {} ({})", part1_bitset, duration_cast<microseconds>(duration2));
+  assert(part1_bitset == CORRECT_ANSWER_PART_1);
+
+  const auto example_lines = read_file(EXAMPLE_FILE);
+  assert(TimelineTable(example_lines).timelines(example_lines.front().find('S')) ==
+         CORRECT_ANSWER_EXAMPLE_2);
+  const auto          input_lines = read_file(INPUT_FILE);
+  const TimelineTable input_table(input_lines);
+  const size_t        input_start = input_lines.front().find('S');
+  assert(input_table.timelines(input_start) == CORRECT_ANSWER_PART2);
+  // Every start column at once, the S column among them
+  const auto start_cols =
+      ranges::views::iota(size_t{0}, input_lines.front().size()) | ranges::to<vector>();
+  const auto all_timelines = input_table.timelines(start_cols);
+  assert(all_timelines[input_start] == CORRECT_ANSWER_PART2);
+  const auto single_lookup = [&input_table](size_t col) { return input_table.timelines(col); };
+  assert(ranges::equal(all_timelines, start_cols | ranges::views::transform(single_lookup)));
+
+  const auto [example1_streaming, example2_streaming] = solve_streaming(EXAMPLE_FILE);
+  assert(example1_streaming == CORRECT_ANSWER_EXAMPLE_1);
+  assert(example2_streaming == CORRECT_ANSWER_EXAMPLE_2);
+
+  auto start3                                   = chrono::high_resolution_clock::now();
+  const auto [part1_streaming, part2_streaming] = solve_streaming(INPUT_FILE);
+  auto duration3                                = high_resolution_clock::now() - start3;
+  println("Streaming part 1: {}\nStreaming part 2: {}\nBoth in: {}",
+          part1_streaming,
+          part2_streaming,
+          duration_cast<microseconds>(duration3));
+  assert(part1_streaming == CORRECT_ANSWER_PART_1);
+  assert(part2_streaming == CORRECT_ANSWER_PART2);
 };
\ No newline at end of file
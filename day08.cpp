@@ -1,15 +1,21 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <fstream>
-#include <list>
 #include <map>
+#include <numeric>
 #include <print>
+#include <queue>
 #include <ranges>
-#include <set>
+#include <span>
 #include <string>
-#include <valarray>
+#include <thread>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -24,36 +30,65 @@ enum DIMS
   Z = 2,
 } DIMS;
 
-class Coordinates : public valarray<int64_t>
+// Junction boxes stored as a structure of arrays, one contiguous int64_t array per dimension
+class Points
 {
  public:
-  using valarray::valarray;
-  auto operator<=>(const Coordinates& other) const
+  void push_back(int64_t x, int64_t y, int64_t z)
   {
-    auto x = (*this)[DIMS::X] <=> other[DIMS::X];
-    auto y = (*this)[DIMS::Y] <=> other[DIMS::Y];
-    auto z = (*this)[DIMS::Z] <=> other[DIMS::Z];
-    if (x == strong_ordering::equal)
+    this->coordinates[DIMS::X].push_back(x);
+    this->coordinates[DIMS::Y].push_back(y);
+    this->coordinates[DIMS::Z].push_back(z);
+  }
+  size_t size() const noexcept
+  {
+    return this->coordinates[DIMS::X].size();
+  }
+  int64_t get(int dim, uint32_t i) const noexcept
+  {
+    return this->coordinates[dim][i];
+  }
+  const vector<int64_t>& dimension(int dim) const noexcept
+  {
+    return this->coordinates[dim];
+  }
+  int64_t distance_squared(uint32_t a, uint32_t b) const noexcept
+  {
+    const int64_t dx = get(DIMS::X, b) - get(DIMS::X, a);
+    const int64_t dy = get(DIMS::Y, b) - get(DIMS::Y, a);
+    const int64_t dz = get(DIMS::Z, b) - get(DIMS::Z, a);
+    return dx * dx + dy * dy + dz * dz;
+  }
+  // Squared distances from point a to every point in [first, last), written to out. A single
+  // loop over the three contiguous arrays, which the compiler vectorises to handle 4 to 8
+  // pairs per instruction.
+  void distances_squared(uint32_t a, uint32_t first, uint32_t last, int64_t* out) const noexcept
+  {
+    const int64_t* xs = this->coordinates[DIMS::X].data();
+    const int64_t* ys = this->coordinates[DIMS::Y].data();
+    const int64_t* zs = this->coordinates[DIMS::Z].data();
+    const int64_t  ax = xs[a];
+    const int64_t  ay = ys[a];
+    const int64_t  az = zs[a];
+    for (uint32_t i = first; i < last; ++i)
     {
-      if (y == strong_ordering::equal)
-      {
-        if (z == strong_ordering::equal)
-        {
-          return strong_ordering::equal;
-        }
-        return z;
-      }
-      return y;
+      const int64_t dx = xs[i] - ax;
+      const int64_t dy = ys[i] - ay;
+      const int64_t dz = zs[i] - az;
+      out[i - first]   = dx * dx + dy * dy + dz * dz;
     }
-    return x;
-  };
+  }
+
+ private:
+  array<vector<int64_t>, 3> coordinates;
 };
 
 class Connection
 {
  public:
-  Connection(const Coordinates* a, const Coordinates* b)
-      : a_ptr(a), b_ptr(b), distance_squared(calc_distance(*a, *b))
+  Connection() = default;
+  Connection(uint32_t a_index, uint32_t b_index, int64_t distance)
+      : a(a_index), b(b_index), distance_squared(distance)
   {
   }
   bool operator<(const Connection& other) const noexcept
@@ -62,28 +97,19 @@ class Connection
   }
   bool operator==(const Connection& other) const noexcept
   {
-    return (this->a_ptr == other.a_ptr && this->b_ptr == other.b_ptr) ||
-           (this->a_ptr == other.b_ptr && this->b_ptr == other.a_ptr);
+    return (this->a == other.a && this->b == other.b) || (this->a == other.b && this->b == other.a);
   }
-  static int64_t calc_distance(const Coordinates& a, const Coordinates& b)
-  {
-    return pow(b - a, 2).sum();
-  }
-  const Coordinates* a_ptr            = nullptr;
-  const Coordinates* b_ptr            = nullptr;
-  int64_t            distance_squared = numeric_limits<int64_t>::max();
+  uint32_t a                = 0;
+  uint32_t b                = 0;
+  int64_t  distance_squared = numeric_limits<int64_t>::max();
 };
 
-using Volume       = pair<Coordinates, Coordinates>;
-using NeighbourMap = map<Coordinates, pair<Coordinates, int64_t>>;
-using Circuit      = set<const Coordinates*>;
-
-vector<Coordinates> read_file(const string& file_name)
+Points read_file(const string& file_name)
 {
-  vector<Coordinates> cvec;
-  ifstream            file(file_name);
-  string              str;
-  const char          divider = ',';
+  Points     points;
+  ifstream   file(file_name);
+  string     str;
+  const char divider = ',';
   while (getline(file, str))
   {
     stringstream ss(str);
@@ -93,97 +119,831 @@ vector<Coordinates> read_file(const string& file_name)
       getline(ss, str, divider);
       c[i] = stoll(str);
     }
-    cvec.emplace_back(Coordinates{c, 3});
+    points.push_back(c[DIMS::X], c[DIMS::Y], c[DIMS::Z]);
   }
-  return cvec;
+  return points;
 }
 
-vector<Connection> all_connections(const vector<Coordinates>& coordinates_vector)
+vector<Connection> all_connections(const Points& points)
 {
+  const uint32_t     n = points.size();
   vector<Connection> all_connections;
-  all_connections.reserve(coordinates_vector.size() * (coordinates_vector.size() - 1) / 2);
-  for (const auto& [i, c] : coordinates_vector | ranges::views::enumerate)
+  all_connections.reserve(size_t{n} * (n - 1) / 2);
+  vector<int64_t> distances(n);
+  for (uint32_t i = 0; i < n; ++i)
   {
-    for (const auto& d : coordinates_vector | ranges::views::drop(i + 1))
+    points.distances_squared(i, i + 1, n, distances.data());
+    for (uint32_t j = i + 1; j < n; ++j)
     {
-      all_connections.push_back(Connection{&c, &d});
+      all_connections.emplace_back(i, j, distances[j - i - 1]);
     }
   }
   return all_connections;
 }
 
-list<Circuit> connect(const vector<Connection>& closest_connections, int64_t num_pairs)
+// Implicit k-d tree. The points of every subtree are a contiguous range of order, split at its
+// middle element along an axis that cycles with the depth.
+class KdTree
 {
-  list<Circuit> circuits;
-  for (const auto& close_connection : closest_connections | ranges::views::take(num_pairs))
+ public:
+  explicit KdTree(const Points& points_store)
+      : points(points_store), order(points_store.size())
+  {
+    iota(this->order.begin(), this->order.end(), 0);
+    build(0, this->order.size(), DIMS::X);
+  }
+  // Calls visit(index, distance_squared) for every point closer to the query point than
+  // bound(). The bound is read again as the search goes on, so visit may shrink it.
+  template <typename Visit, typename Bound>
+  void search(uint32_t query, Visit&& visit, Bound&& bound) const
+  {
+    const auto keep_all = [](size_t) noexcept { return false; };
+    search(query, 0, this->order.size(), DIMS::X, visit, bound, keep_all);
+  }
+  // As above, but skips every subtree for which skip(middle) holds. Subtrees are identified by
+  // the position of their middle point, as in label_subtrees.
+  template <typename Visit, typename Bound, typename Skip>
+  void search(uint32_t query, Visit&& visit, Bound&& bound, Skip&& skip) const
+  {
+    search(query, 0, this->order.size(), DIMS::X, visit, bound, skip);
+  }
+  // Stores, at the middle position of every subtree, the label all of its points share, or none
+  // if they differ. One bottom-up pass, linear in the number of points.
+  template <typename LabelOf>
+  void label_subtrees(LabelOf&& label_of, uint32_t none, vector<uint32_t>& labels) const
+  {
+    labels.resize(this->order.size());
+    label_subtrees(0, this->order.size(), label_of, none, labels);
+  }
+
+ private:
+  void build(size_t first, size_t last, int axis)
+  {
+    if (last - first <= 1)
+    {
+      return;
+    }
+    const size_t middle = (first + last) / 2;
+    nth_element(this->order.begin() + first,
+                this->order.begin() + middle,
+                this->order.begin() + last,
+                [this, axis](uint32_t a, uint32_t b)
+                { return this->points.get(axis, a) < this->points.get(axis, b); });
+    build(first, middle, (axis + 1) % 3);
+    build(middle + 1, last, (axis + 1) % 3);
+  }
+  template <typename LabelOf>
+  uint32_t label_subtrees(size_t            first,
+                          size_t            last,
+                          LabelOf&          label_of,
+                          uint32_t          none,
+                          vector<uint32_t>& labels) const
+  {
+    const size_t   middle = (first + last) / 2;
+    const uint32_t label  = label_of(this->order[middle]);
+    const uint32_t below =
+        first < middle ? label_subtrees(first, middle, label_of, none, labels) : label;
+    const uint32_t above =
+        middle + 1 < last ? label_subtrees(middle + 1, last, label_of, none, labels) : label;
+    labels[middle] = below == label && above == label ? label : none;
+    return labels[middle];
+  }
+  template <typename Visit, typename Bound, typename Skip>
+  void search(uint32_t query,
+              size_t   first,
+              size_t   last,
+              int      axis,
+              Visit&   visit,
+              Bound&   bound,
+              Skip&    skip) const
+  {
+    if (first >= last)
+    {
+      return;
+    }
+    const size_t middle = (first + last) / 2;
+    if (skip(middle))
+    {
+      return;
+    }
+    const uint32_t index    = this->order[middle];
+    const int64_t  distance = this->points.distance_squared(query, index);
+    if (distance < bound())
+    {
+      visit(index, distance);
+    }
+    const int64_t delta     = this->points.get(axis, query) - this->points.get(axis, index);
+    const int     next_axis = (axis + 1) % 3;
+    // Search the side of the query point first, the other side only if it can still matter
+    if (delta < 0)
+    {
+      search(query, first, middle, next_axis, visit, bound, skip);
+      if (delta * delta < bound())
+      {
+        search(query, middle + 1, last, next_axis, visit, bound, skip);
+      }
+    }
+    else
+    {
+      search(query, middle + 1, last, next_axis, visit, bound, skip);
+      if (delta * delta < bound())
+      {
+        search(query, first, middle, next_axis, visit, bound, skip);
+      }
+    }
+  }
+  const Points&    points;
+  vector<uint32_t> order;
+};
+
+// The k shortest connections in ascending order. Every point searches the k-d tree for later
+// points within the current bound, which is the longest connection kept in a bounded max-heap
+// once that holds k connections.
+vector<Connection> closest_connections(const Points& points, size_t k)
+{
+  if (k == 0)
+  {
+    return {};
+  }
+  const KdTree               tree(points);
+  priority_queue<Connection> closest;
+  const auto                 bound = [&closest, k]() noexcept
   {
-    vector<Circuit*> to_be_removed;
-    Circuit          new_circuit{close_connection.a_ptr, close_connection.b_ptr};
-    for (auto& circuit : circuits)
+    return closest.size() < k ? numeric_limits<int64_t>::max() : closest.top().distance_squared;
+  };
+  for (uint32_t i = 0; i < points.size(); ++i)
+  {
+    const auto visit = [&closest, i, k](uint32_t j, int64_t distance)
     {
-      if (circuit.contains(close_connection.a_ptr) || circuit.contains(close_connection.b_ptr))
+      if (j <= i)
+      {
+        return;
+      }
+      closest.emplace(i, j, distance);
+      if (closest.size() > k)
       {
-        new_circuit.merge(circuit);
-        to_be_removed.push_back(&circuit);
+        closest.pop();
       }
+    };
+    tree.search(i, visit, bound);
+  }
+  vector<Connection> connections;
+  connections.reserve(closest.size());
+  for (; !closest.empty(); closest.pop())
+  {
+    connections.push_back(closest.top());
+  }
+  ranges::reverse(connections);
+  return connections;
+}
+
+// Disjoint-set forest over point indices with path compression and union by size
+class DisjointSets
+{
+ public:
+  explicit DisjointSets(size_t n)
+      : parent(n), sizes(n, 1), num_components(n)
+  {
+    iota(this->parent.begin(), this->parent.end(), 0);
+  }
+  size_t find(size_t i)
+  {
+    size_t root = i;
+    while (this->parent[root] != root)
+    {
+      root = this->parent[root];
+    }
+    while (this->parent[i] != root)
+    {
+      i = exchange(this->parent[i], root);
+    }
+    return root;
+  }
+  // Returns false if a and b already were in the same set
+  bool unite(size_t a, size_t b)
+  {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+    {
+      return false;
     }
-    for (auto circuit_ptr : to_be_removed)
+    if (this->sizes[a] < this->sizes[b])
     {
-      circuits.remove(*circuit_ptr);
+      swap(a, b);
     }
-    circuits.push_back(new_circuit);
+    this->parent[b] = a;
+    this->sizes[a] += this->sizes[b];
+    --this->num_components;
+    return true;
+  }
+  size_t size_of(size_t i)
+  {
+    return this->sizes[find(i)];
+  }
+  size_t get_num_components() const
+  {
+    return this->num_components;
+  }
+  vector<size_t> component_sizes() const
+  {
+    vector<size_t> component_sizes;
+    component_sizes.reserve(this->num_components);
+    for (size_t i = 0; i < this->parent.size(); ++i)
+    {
+      if (this->parent[i] == i)
+      {
+        component_sizes.push_back(this->sizes[i]);
+      }
+    }
+    return component_sizes;
+  }
+
+ private:
+  vector<size_t> parent;
+  vector<size_t> sizes;
+  size_t         num_components = 0;
+};
+
+DisjointSets connect(const Points&             points,
+                     const vector<Connection>& closest_connections,
+                     int64_t                   num_pairs)
+{
+  DisjointSets circuits(points.size());
+  for (const auto& close_connection : closest_connections | ranges::views::take(num_pairs))
+  {
+    circuits.unite(close_connection.a, close_connection.b);
   }
   return circuits;
 }
 
-int64_t solve1(const string& file_name, int64_t num_pairs)
+int64_t three_largest_product(const DisjointSets& circuits)
 {
-  const auto cvec        = read_file(file_name);
-  auto       connections = all_connections(cvec);
-  sort(connections.begin(), connections.end());
-  const auto circuits = connect(connections, num_pairs);
-  auto       circuit_sizes =
-      circuits |
-      ranges::views::transform([](const auto& circuit) noexcept { return circuit.size(); }) |
-      ranges::to<vector>();
-  sort(circuit_sizes.begin(), circuit_sizes.end(), greater{});
+  auto circuit_sizes = circuits.component_sizes();
+  ranges::partial_sort(
+      circuit_sizes, circuit_sizes.begin() + min<size_t>(3, circuit_sizes.size()), greater{});
   return ranges::fold_left_first(circuit_sizes | ranges::views::take(3), multiplies{}).value();
 }
 
-int64_t connect_all(const vector<Connection>& closest_connections, size_t number_of_nodes)
+int64_t solve1(const string& file_name, int64_t num_pairs)
 {
-  list<Circuit> circuits;
+  const auto points = read_file(file_name);
+  return three_largest_product(connect(points, closest_connections(points, num_pairs), num_pairs));
+}
+
+int64_t connect_all(const Points& points, const vector<Connection>& closest_connections)
+{
+  DisjointSets circuits(points.size());
   for (const auto& close_connection : closest_connections)
   {
-    vector<Circuit*> to_be_removed;
-    Circuit          new_circuit{close_connection.a_ptr, close_connection.b_ptr};
-    for (auto& circuit : circuits)
+    circuits.unite(close_connection.a, close_connection.b);
+    if (circuits.get_num_components() == 1)
+    {
+      return points.get(DIMS::X, close_connection.a) * points.get(DIMS::X, close_connection.b);
+    }
+  }
+  return 0;  // Should not be reached
+}
+
+int64_t solve2(const string& file_name)
+{
+  const auto points      = read_file(file_name);
+  auto       connections = all_connections(points);
+  sort(connections.begin(), connections.end());
+  return connect_all(points, connections);
+}
+
+// Runs task(t) for every t in [0, num_threads), each on its own thread, and waits for them
+template <typename Task>
+void parallel_for(size_t num_threads, Task task)
+{
+  vector<jthread> threads;
+  for (size_t t = 0; t < num_threads; ++t)
+  {
+    threads.emplace_back(task, t);
+  }
+}
+
+// Row i of the pair triangle holds the connections (i, j) with j > i
+size_t row_offset(size_t n, size_t i)
+{
+  return i * (2 * n - i - 1) / 2;
+}
+
+// Splits the rows of the pair triangle into num_threads ranges holding about as many pairs each
+vector<uint32_t> balanced_row_ranges(uint32_t n, size_t num_threads)
+{
+  vector<uint32_t> boundaries{0};
+  for (size_t t = 1; t < num_threads; ++t)
+  {
+    const size_t target = row_offset(n, n) * t / num_threads;
+    boundaries.push_back(*ranges::partition_point(ranges::views::iota(uint32_t{0}, n),
+                                                  [n, target](uint32_t row)
+                                                  { return row_offset(n, row) < target; }));
+  }
+  boundaries.push_back(n);
+  return boundaries;
+}
+
+// Every thread fills the connections of its own rows of the pair triangle straight into their
+// final place, computing the distances of one row at a time into its own buffer
+vector<Connection> all_connections_parallel(const Points& points, size_t num_threads)
+{
+  const uint32_t     n    = points.size();
+  const auto         rows = balanced_row_ranges(n, num_threads);
+  vector<Connection> connections(row_offset(n, n));
+  parallel_for(num_threads,
+               [&points, &connections, &rows, n](size_t t)
+               {
+                 vector<int64_t> distances(n);
+                 for (uint32_t i = rows[t]; i < rows[t + 1]; ++i)
+                 {
+                   points.distances_squared(i, i + 1, n, distances.data());
+                   Connection* row = &connections[row_offset(n, i)];
+                   for (uint32_t j = i + 1; j < n; ++j)
+                   {
+                     row[j - i - 1] = Connection{i, j, distances[j - i - 1]};
+                   }
+                 }
+               });
+  return connections;
+}
+
+// LSD radix sort on distance_squared, 8 bits per pass. Every thread counts the digits of its own
+// chunk, the counts are turned into per-thread offsets, and every thread then scatters its
+// chunk. Only as many passes run as the largest distance needs.
+void radix_sort_parallel(vector<Connection>& connections, size_t num_threads)
+{
+  const size_t    n     = connections.size();
+  const auto      chunk = [n, num_threads](size_t t) { return n * t / num_threads; };
+  vector<int64_t> largest(num_threads, 0);
+  parallel_for(num_threads,
+               [&](size_t t)
+               {
+                 for (size_t i = chunk(t); i < chunk(t + 1); ++i)
+                 {
+                   largest[t] = max(largest[t], connections[i].distance_squared);
+                 }
+               });
+  const int                  key_bits = bit_width(static_cast<uint64_t>(ranges::max(largest)));
+  vector<Connection>         buffer(n);
+  vector<array<size_t, 256>> offsets(num_threads);
+  for (int shift = 0; shift < key_bits; shift += 8)
+  {
+    parallel_for(num_threads,
+                 [&](size_t t)
+                 {
+                   offsets[t].fill(0);
+                   for (size_t i = chunk(t); i < chunk(t + 1); ++i)
+                   {
+                     ++offsets[t][(connections[i].distance_squared >> shift) & 0xff];
+                   }
+                 });
+    size_t position = 0;
+    for (size_t digit = 0; digit < 256; ++digit)
     {
-      if (circuit.contains(close_connection.a_ptr) || circuit.contains(close_connection.b_ptr))
+      for (auto& thread_offsets : offsets)
       {
-        new_circuit.merge(circuit);
-        to_be_removed.push_back(&circuit);
+        position += exchange(thread_offsets[digit], position);
       }
     }
-    if (new_circuit.size() == number_of_nodes)
+    parallel_for(num_threads,
+                 [&](size_t t)
+                 {
+                   for (size_t i = chunk(t); i < chunk(t + 1); ++i)
+                   {
+                     buffer[offsets[t][(connections[i].distance_squared >> shift) & 0xff]++] =
+                         connections[i];
+                   }
+                 });
+    swap(connections, buffer);
+  }
+}
+
+// The k shortest connections in ascending order. Every thread walks its own rows of the pair
+// triangle and keeps its k best connections, trimming its buffer with nth_element whenever it
+// holds 2k, so memory stays O(k) per thread. The survivors are then merged.
+vector<Connection> closest_connections_parallel(const Points& points,
+                                                size_t        k,
+                                                size_t        num_threads)
+{
+  if (k == 0)
+  {
+    return {};
+  }
+  const uint32_t             n    = points.size();
+  const auto                 rows = balanced_row_ranges(n, num_threads);
+  vector<vector<Connection>> candidates(num_threads);
+  parallel_for(num_threads,
+               [&points, &candidates, &rows, n, k](size_t t)
+               {
+                 auto&           kept = candidates[t];
+                 vector<int64_t> distances(n);
+                 for (uint32_t i = rows[t]; i < rows[t + 1]; ++i)
+                 {
+                   points.distances_squared(i, i + 1, n, distances.data());
+                   for (uint32_t j = i + 1; j < n; ++j)
+                   {
+                     kept.emplace_back(i, j, distances[j - i - 1]);
+                   }
+                   if (kept.size() >= 2 * k)
+                   {
+                     nth_element(kept.begin(), kept.begin() + k, kept.end());
+                     kept.resize(k);
+                   }
+                 }
+               });
+  vector<Connection> connections;
+  for (const auto& kept : candidates)
+  {
+    connections.insert_range(connections.end(), kept);
+  }
+  const size_t num_closest = min(k, connections.size());
+  partial_sort(connections.begin(), connections.begin() + num_closest, connections.end());
+  connections.resize(num_closest);
+  return connections;
+}
+
+int64_t solve1_parallel(const string& file_name,
+                        int64_t       num_pairs,
+                        size_t        num_threads = thread::hardware_concurrency())
+{
+  const auto points = read_file(file_name);
+  num_threads       = clamp<size_t>(num_threads, 1, max<size_t>(points.size(), 1));
+  return three_largest_product(
+      connect(points, closest_connections_parallel(points, num_pairs, num_threads), num_pairs));
+}
+
+int64_t solve2_parallel(const string& file_name,
+                        size_t        num_threads = thread::hardware_concurrency())
+{
+  const auto points = read_file(file_name);
+  num_threads       = clamp<size_t>(num_threads, 1, max<size_t>(points.size(), 1));
+  auto connections  = all_connections_parallel(points, num_threads);
+  radix_sort_parallel(connections, num_threads);
+  return connect_all(points, connections);
+}
+
+// Lock-free disjoint-set forest. A root is linked under another with compare-and-swap, always
+// the larger index under the smaller one, and every find halves the path it walks.
+class ConcurrentDisjointSets
+{
+ public:
+  explicit ConcurrentDisjointSets(size_t n)
+      : parent(n), num_components(n)
+  {
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      this->parent[i].store(i, memory_order_relaxed);
+    }
+  }
+  uint32_t find(uint32_t i)
+  {
+    while (true)
     {
-      return (*close_connection.a_ptr)[DIMS::X] * (*close_connection.b_ptr)[DIMS::X];
+      uint32_t p = this->parent[i].load();
+      if (p == i)
+      {
+        return i;
+      }
+      const uint32_t grandparent = this->parent[p].load();
+      if (p != grandparent)
+      {
+        this->parent[i].compare_exchange_weak(p, grandparent);
+      }
+      i = grandparent;
     }
-    for (auto circuit_ptr : to_be_removed)
+  }
+  // Returns false if a and b already were in the same set
+  bool unite(uint32_t a, uint32_t b)
+  {
+    while (true)
     {
-      circuits.remove(*circuit_ptr);
+      a = find(a);
+      b = find(b);
+      if (a == b)
+      {
+        return false;
+      }
+      if (a < b)
+      {
+        swap(a, b);
+      }
+      // Fails if a stopped being a root in the meantime
+      uint32_t expected = a;
+      if (this->parent[a].compare_exchange_strong(expected, b))
+      {
+        --this->num_components;
+        return true;
+      }
     }
-    circuits.push_back(new_circuit);
   }
-  return 0;  // Should not be reached
+  size_t get_num_components() const
+  {
+    return this->num_components.load();
+  }
+
+ private:
+  vector<atomic<uint32_t>> parent;
+  atomic<size_t>           num_components;
+};
+
+// Borůvka minimum spanning tree for large point clouds. In every round each point searches the
+// k-d tree, in parallel, for its nearest neighbour outside its own circuit, and every circuit
+// keeps the shortest of those connections through compare-and-swap. The kept connections are
+// then united in parallel through a lock-free disjoint-set forest. Ties are broken on the point
+// indices, so the kept connections never form a cycle and every round at least halves the
+// number of circuits. The last connection Kruskal would make is the longest one in the tree.
+//
+// Searches stay cheap as circuits grow: subtrees whose points all lie in the query's circuit
+// are skipped, a neighbour from the previous round that is still outside is still the nearest,
+// and other searches are bounded by the best connection their circuit has published so far.
+int64_t solve2_boruvka(const string& file_name,
+                       size_t        num_threads = thread::hardware_concurrency())
+{
+  const auto     points = read_file(file_name);
+  const uint32_t n      = points.size();
+  if (n < 2)
+  {
+    return 0;
+  }
+  num_threads          = clamp<size_t>(num_threads, 1, n);
+  const uint32_t NONE  = numeric_limits<uint32_t>::max();
+  const int64_t  FAR   = numeric_limits<int64_t>::max();
+  const auto     chunk = [n, num_threads](size_t t) -> uint32_t { return n * t / num_threads; };
+  const auto     shorter = [](const Connection& x, const Connection& y) noexcept
+  {
+    return tuple{x.distance_squared, min(x.a, x.b), max(x.a, x.b)} <
+           tuple{y.distance_squared, min(y.a, y.b), max(y.a, y.b)};
+  };
+  const KdTree           tree(points);
+  ConcurrentDisjointSets circuits(n);
+  vector<uint32_t>       circuit_of(n);
+  // Nearest outside neighbour of every point, and the point holding the best one per circuit
+  vector<Connection>       nearest(n, Connection{0, 0, FAR});
+  vector<atomic<uint32_t>> best(n);
+  vector<Connection>       longest(num_threads, Connection{0, 0, -1});
+  // Circuit shared by all points of every k-d subtree, keyed by the subtree's middle position
+  vector<uint32_t> subtree_circuit(n);
+  while (circuits.get_num_components() > 1)
+  {
+    parallel_for(num_threads,
+                 [&](size_t t)
+                 {
+                   for (uint32_t i = chunk(t); i < chunk(t + 1); ++i)
+                   {
+                     circuit_of[i] = circuits.find(i);
+                     best[i].store(NONE);
+                   }
+                 });
+    tree.label_subtrees([&circuit_of](uint32_t i) { return circuit_of[i]; }, NONE,
+                        subtree_circuit);
+    parallel_for(num_threads,
+                 [&](size_t t)
+                 {
+                   for (uint32_t i = chunk(t); i < chunk(t + 1); ++i)
+                   {
+                     auto&      candidate    = nearest[i];
+                     auto&      circuit_best = best[circuit_of[i]];
+                     const bool still_outside =
+                         candidate.distance_squared != FAR &&
+                         circuit_of[candidate.b] != circuit_of[i];
+                     if (!still_outside)
+                     {
+                       // Only a connection at least as short as the circuit's best can matter
+                       const uint32_t holder = circuit_best.load();
+                       const int64_t  seed =
+                           holder == NONE ? FAR : nearest[holder].distance_squared;
+                       candidate = Connection{i, i, FAR};
+                       // Equally distant points must be visited too for the tie-break
+                       const auto bound = [&candidate, seed, FAR]() noexcept
+                       {
+                         const int64_t shortest = min(candidate.distance_squared, seed);
+                         return shortest == FAR ? FAR : shortest + 1;
+                       };
+                       const auto visit = [&](uint32_t j, int64_t distance)
+                       {
+                         const Connection connection{i, j, distance};
+                         if (circuit_of[j] != circuit_of[i] && shorter(connection, candidate))
+                         {
+                           candidate = connection;
+                         }
+                       };
+                       const auto skip = [&](size_t middle) noexcept
+                       { return subtree_circuit[middle] == circuit_of[i]; };
+                       tree.search(i, visit, bound, skip);
+                     }
+                     uint32_t current = circuit_best.load();
+                     while (candidate.distance_squared != FAR &&
+                            (current == NONE || shorter(candidate, nearest[current])) &&
+                            !circuit_best.compare_exchange_weak(current, i))
+                     {
+                     }
+                   }
+                 });
+    parallel_for(num_threads,
+                 [&](size_t t)
+                 {
+                   for (uint32_t root = chunk(t); root < chunk(t + 1); ++root)
+                   {
+                     const uint32_t holder = best[root].load();
+                     if (circuit_of[root] != root || holder == NONE)
+                     {
+                       continue;
+                     }
+                     const auto& connection = nearest[holder];
+                     if (circuits.unite(connection.a, connection.b) &&
+                         shorter(longest[t], connection))
+                     {
+                       longest[t] = connection;
+                     }
+                   }
+                 });
+  }
+  const auto& last = *ranges::max_element(longest, shorter);
+  return points.get(DIMS::X, last.a) * points.get(DIMS::X, last.b);
 }
 
-int64_t solve2(const string& file_name)
+// Circuit statistics after any number of connections, from a single Kruskal pass. Every union
+// is recorded as the index of its connection and the two sizes it joined, and the histogram of
+// circuit sizes is saved every SNAPSHOT_INTERVAL unions. A query binary searches how many
+// unions its connections made and replays at most SNAPSHOT_INTERVAL of them on a snapshot.
+class ClusteringHistory
 {
-  const auto cvec        = read_file(file_name);
-  auto       connections = all_connections(cvec);
-  sort(connections.begin(), connections.end());
-  return connect_all(connections, cvec.size());
+ public:
+  ClusteringHistory(size_t point_count, const vector<Connection>& sorted_connections)
+      : num_points(point_count)
+  {
+    DisjointSets        circuits(point_count);
+    map<size_t, size_t> histogram;
+    if (point_count > 0)
+    {
+      histogram[1] = point_count;
+    }
+    this->snapshots.push_back(histogram);
+    for (const auto& [index, connection] : sorted_connections | ranges::views::enumerate)
+    {
+      if (circuits.get_num_components() == 1)
+      {
+        break;
+      }
+      const auto size_a = circuits.size_of(connection.a);
+      const auto size_b = circuits.size_of(connection.b);
+      if (!circuits.unite(connection.a, connection.b))
+      {
+        continue;
+      }
+      this->unions.push_back({static_cast<size_t>(index), size_a, size_b});
+      apply(histogram, this->unions.back());
+      if (this->unions.size() % SNAPSHOT_INTERVAL == 0)
+      {
+        this->snapshots.push_back(histogram);
+      }
+    }
+  }
+  size_t num_components(size_t num_connections) const
+  {
+    return this->num_points - num_unions(num_connections);
+  }
+  // Number of circuits of every size
+  map<size_t, size_t> size_histogram(size_t num_connections) const
+  {
+    const size_t count     = num_unions(num_connections);
+    const size_t snapshot  = count / SNAPSHOT_INTERVAL;
+    auto         histogram = this->snapshots[snapshot];
+    for (size_t u = snapshot * SNAPSHOT_INTERVAL; u < count; ++u)
+    {
+      apply(histogram, this->unions[u]);
+    }
+    return histogram;
+  }
+  int64_t three_largest_product(size_t num_connections) const
+  {
+    int64_t product   = 1;
+    int     remaining = 3;
+    for (const auto& [size, count] : size_histogram(num_connections) | ranges::views::reverse)
+    {
+      for (size_t i = 0; i < count && remaining > 0; ++i, --remaining)
+      {
+        product *= size;
+      }
+    }
+    return product;
+  }
+
+ private:
+  static constexpr size_t SNAPSHOT_INTERVAL = 64;
+  struct Union
+  {
+    size_t connection;
+    size_t size_a;
+    size_t size_b;
+  };
+  static void apply(map<size_t, size_t>& histogram, const Union& u)
+  {
+    for (const auto size : {u.size_a, u.size_b})
+    {
+      if (--histogram[size] == 0)
+      {
+        histogram.erase(size);
+      }
+    }
+    ++histogram[u.size_a + u.size_b];
+  }
+  size_t num_unions(size_t num_connections) const
+  {
+    return ranges::partition_point(this->unions,
+                                   [num_connections](const Union& u)
+                                   { return u.connection < num_connections; }) -
+           this->unions.begin();
+  }
+  size_t                      num_points = 0;
+  vector<Union>               unions;
+  vector<map<size_t, size_t>> snapshots;
+};
+
+// Part 1 for many numbers of connections at the cost of one
+vector<int64_t> solve1_thresholds(const string& file_name, span<const int64_t> thresholds)
+{
+  const auto points = read_file(file_name);
+  const auto history =
+      ClusteringHistory(points.size(), closest_connections(points, ranges::max(thresholds)));
+  vector<int64_t> products;
+  for (const auto num_pairs : thresholds)
+  {
+    products.push_back(history.three_largest_product(num_pairs));
+  }
+  return products;
+}
+
+// Dense Prim over the flat x, y and z arrays, for point counts whose connections do not fit in
+// memory. The points outside the tree are kept packed at the front of the arrays, so adding the
+// closest one and relaxing the others against it are plain loops over contiguous int64_t
+// arrays that the compiler vectorises. No connection is stored: O(n^2) time and O(n) memory.
+// The last connection Kruskal would make is the longest one of the minimum spanning tree.
+int64_t solve2_prim(const string& file_name)
+{
+  const auto points = read_file(file_name);
+  size_t     n      = points.size();
+  if (n < 2)
+  {
+    return 0;
+  }
+  // Working copies that get reordered as points join the tree
+  auto xs = points.dimension(DIMS::X);
+  auto ys = points.dimension(DIMS::Y);
+  auto zs = points.dimension(DIMS::Z);
+  // Closest tree point of every point outside the tree
+  vector<int64_t>  distances(n, numeric_limits<int64_t>::max());
+  vector<uint32_t> closest(n, 0);
+  vector<uint32_t> ids(n);
+  iota(ids.begin(), ids.end(), 0);
+  int64_t  longest = -1;
+  uint32_t a_id    = 0;
+  uint32_t b_id    = 0;
+  // Start the tree with the last point
+  uint32_t new_id = ids[--n];
+  int64_t  new_x  = xs[n];
+  int64_t  new_y  = ys[n];
+  int64_t  new_z  = zs[n];
+  while (n > 0)
+  {
+    // Relax and take the shortest distance in the same pass. The value-only min reduction
+    // vectorises along with the relaxation, and its index is located afterwards.
+    int64_t shortest = numeric_limits<int64_t>::max();
+    for (size_t i = 0; i < n; ++i)
+    {
+      const int64_t dx       = xs[i] - new_x;
+      const int64_t dy       = ys[i] - new_y;
+      const int64_t dz       = zs[i] - new_z;
+      const int64_t distance = dx * dx + dy * dy + dz * dz;
+      const bool    closer   = distance < distances[i];
+      distances[i]           = closer ? distance : distances[i];
+      closest[i]             = closer ? new_id : closest[i];
+      shortest               = min(shortest, distances[i]);
+    }
+    const auto   last = distances.begin() + n;
+    const size_t next = find(distances.begin(), last, shortest) - distances.begin();
+    if (shortest >= longest)
+    {
+      longest = shortest;
+      a_id    = closest[next];
+      b_id    = ids[next];
+    }
+    new_id = ids[next];
+    new_x  = xs[next];
+    new_y  = ys[next];
+    new_z  = zs[next];
+    // Move the last point outside the tree into the freed slot
+    --n;
+    xs[next]        = xs[n];
+    ys[next]        = ys[n];
+    zs[next]        = zs[n];
+    distances[next] = distances[n];
+    closest[next]   = closest[n];
+    ids[next]       = ids[n];
+  }
+  return points.get(DIMS::X, a_id) * points.get(DIMS::X, b_id);
 }
 
 int main()
@@ -214,4 +974,42 @@ int main()
   println("Answer  part 2: {} ({})", part2, duration_cast<microseconds>(duration2));
   const int64_t CORRECT_ANSWER_PART2 = 8141888143;
   assert(part2 == CORRECT_ANSWER_PART2);
+
+  assert(solve2_prim(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+
+  auto          start3     = chrono::high_resolution_clock::now();
+  const int64_t part2_prim = solve2_prim(INPUT_FILE);
+  auto          duration3  = chrono::high_resolution_clock::now() - start3;
+  println("Prim    part 2: {} ({})", part2_prim, duration_cast<microseconds>(duration3));
+  assert(part2_prim == CORRECT_ANSWER_PART2);
+
+  assert(solve1_parallel(EXAMPLE_FILE, 10) == CORRECT_ANSWER_EXAMPLE_1);
+  assert(solve2_parallel(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+
+  auto          start4         = chrono::high_resolution_clock::now();
+  const int64_t part1_parallel = solve1_parallel(INPUT_FILE, 1000);
+  const int64_t part2_parallel = solve2_parallel(INPUT_FILE);
+  auto          duration4      = chrono::high_resolution_clock::now() - start4;
+  println("Parallel part 1: {}\nParallel part 2: {}\nBoth in: {}",
+          part1_parallel,
+          part2_parallel,
+          duration_cast<microseconds>(duration4));
+  assert(part1_parallel == CORRECT_ANSWER_PART_1);
+  assert(part2_parallel == CORRECT_ANSWER_PART2);
+
+  assert(solve2_boruvka(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+
+  auto          start5        = chrono::high_resolution_clock::now();
+  const int64_t part2_boruvka = solve2_boruvka(INPUT_FILE);
+  auto          duration5     = chrono::high_resolution_clock::now() - start5;
+  println("Boruvka part 2: {} ({})", part2_boruvka, duration_cast<microseconds>(duration5));
+  assert(part2_boruvka == CORRECT_ANSWER_PART2);
+
+  assert(solve1_thresholds(EXAMPLE_FILE, vector<int64_t>{10}).front() == CORRECT_ANSWER_EXAMPLE_1);
+  const vector<int64_t> thresholds{10, 100, 1000};
+  const auto            products = solve1_thresholds(INPUT_FILE, thresholds);
+  for (const auto& [num_pairs, product] : ranges::views::zip(thresholds, products))
+  {
+    assert(product == solve1(INPUT_FILE, num_pairs));
+  }
 };
\ No newline at end of file
@@ -1,10 +1,16 @@
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cmath>
 #include <fstream>
+#include <iterator>
 #include <print>
 #include <ranges>
+#include <span>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <valarray>
 #include <vector>
 
@@ -137,6 +143,139 @@ int64_t solve1(const string& file_name)
   return biggest_area;
 }
 
+// Red tile as a plain pair of integers, cheaper to sort and copy than a valarray
+struct Tile
+{
+  int64_t x = 0;
+  int64_t y = 0;
+};
+
+vector<Tile> to_tiles(const vector<Coordinates>& coordinates)
+{
+  return coordinates |
+         ranges::views::transform([](const Coordinates& c)
+                                  { return Tile{c[Dim::X], c[Dim::Y]}; }) |
+         ranges::to<vector>();
+}
+
+int64_t area_between(const Tile& a, const Tile& b)
+{
+  return (abs(a.x - b.x) + 1) * (abs(a.y - b.y) + 1);
+}
+
+int64_t biggest_area_brute_force(span<const Tile> tiles)
+{
+  int64_t biggest_area = 0;
+  for (size_t i = 0; i < tiles.size(); ++i)
+  {
+    for (size_t j = i + 1; j < tiles.size(); ++j)
+    {
+      biggest_area = max(biggest_area, area_between(tiles[i], tiles[j]));
+    }
+  }
+  return biggest_area;
+}
+
+// Tiles with no other tile below and to the left of them, by increasing x and decreasing y
+vector<Tile> lower_left_chain(vector<Tile> tiles)
+{
+  ranges::sort(tiles, {}, [](const Tile& t) { return pair{t.x, t.y}; });
+  vector<Tile> chain;
+  for (const auto& tile : tiles)
+  {
+    if (chain.empty() || tile.y < chain.back().y)
+    {
+      chain.push_back(tile);
+    }
+  }
+  return chain;
+}
+
+// Tiles with no other tile above and to the right of them, by increasing x and decreasing y
+vector<Tile> upper_right_chain(vector<Tile> tiles)
+{
+  ranges::sort(tiles, greater{}, [](const Tile& t) { return pair{t.x, t.y}; });
+  vector<Tile> chain;
+  for (const auto& tile : tiles)
+  {
+    if (chain.empty() || tile.y > chain.back().y)
+    {
+      chain.push_back(tile);
+    }
+  }
+  ranges::reverse(chain);
+  return chain;
+}
+
+// Signed area spanned from a lower-left corner to an upper-right corner. It never exceeds the
+// real area of the pair, and over two staircases it satisfies the inverse Monge condition, so
+// the best upper corner moves right monotonically as the lower corner does.
+int64_t spanned_area(const Tile& lower, const Tile& upper)
+{
+  return (upper.x - lower.x + 1) * (upper.y - lower.y + 1);
+}
+
+// Divide and conquer over the lower chain: the best partner of the middle corner splits the
+// candidate partners of the two halves.
+void search_chains(span<const Tile> lower,
+                   span<const Tile> upper,
+                   size_t           first,
+                   size_t           last,
+                   size_t           opt_first,
+                   size_t           opt_last,
+                   int64_t&         biggest_area)
+{
+  if (first >= last)
+  {
+    return;
+  }
+  const auto mid       = first + (last - first) / 2;
+  auto       best_opt  = opt_first;
+  auto       best_area = spanned_area(lower[mid], upper[opt_first]);
+  for (auto j = opt_first + 1; j <= opt_last; ++j)
+  {
+    const auto area = spanned_area(lower[mid], upper[j]);
+    if (area > best_area)
+    {
+      best_area = area;
+      best_opt  = j;
+    }
+  }
+  biggest_area = max(biggest_area, best_area);
+  search_chains(lower, upper, first, mid, opt_first, best_opt, biggest_area);
+  search_chains(lower, upper, mid + 1, last, best_opt, opt_last, biggest_area);
+}
+
+int64_t biggest_spanned_area(const vector<Tile>& tiles)
+{
+  const auto lower        = lower_left_chain(tiles);
+  const auto upper        = upper_right_chain(tiles);
+  int64_t    biggest_area = 0;
+  search_chains(lower, upper, 0, lower.size(), 0, upper.size() - 1, biggest_area);
+  return biggest_area;
+}
+
+// Only corners of the four staircase hulls can span the biggest rectangle. Mirroring y turns the
+// upper-left and lower-right hulls into the lower-left and upper-right ones.
+int64_t biggest_area_extreme(vector<Tile> tiles, size_t brute_force_limit = 64)
+{
+  if (tiles.size() <= brute_force_limit || tiles.size() < 2)
+  {
+    return biggest_area_brute_force(tiles);
+  }
+  const auto rising = biggest_spanned_area(tiles);
+  for (auto& tile : tiles)
+  {
+    tile.y = -tile.y;
+  }
+  return max(rising, biggest_spanned_area(tiles));
+}
+
+int64_t solve1_extreme(const string& file_name, size_t brute_force_limit = 64)
+{
+  return biggest_area_extreme(to_tiles(read_file(file_name)), brute_force_limit);
+}
+
 vector<LineSegment> get_line_segments(const vector<Coordinates>& coordinates_vector,
                                       bool&                      is_clockwise)
 {
@@ -237,6 +376,374 @@ int64_t biggest_area(const vector<Coordinates>& coordinates,
   return biggest_area;
 }
 
+// Polygon edges of one orientation sorted on their fixed coordinate, in a merge-sort tree over
+// that order. Every node keeps the spans of its edges sorted on their start, with a running
+// maximum of their stops, so whether any of them reaches into a span is one binary search.
+class EdgeIndex
+{
+ public:
+  EdgeIndex(const vector<LineSegment>& line_segments, int dimension)
+      : fixed_dim(dimension)
+  {
+    const auto span_dim = 1 - dimension;
+    vector<Edge> edges;
+    for (const auto& ls : line_segments)
+    {
+      if (ls.start[dimension] != ls.stop[dimension])
+      {
+        continue;
+      }
+      edges.push_back(Edge{ls.start[dimension],
+                           min(ls.start[span_dim], ls.stop[span_dim]),
+                           max(ls.start[span_dim], ls.stop[span_dim])});
+    }
+    ranges::sort(edges, {}, &Edge::fixed);
+    this->fixed_coordinates = edges | ranges::views::transform(&Edge::fixed) | ranges::to<vector>();
+    if (!edges.empty())
+    {
+      this->nodes.resize(4 * edges.size());
+      this->build(1, 0, edges.size(), edges);
+    }
+  }
+  // An edge whose fixed coordinate lies strictly between the rectangle's sides, and whose span
+  // reaches strictly into the rectangle, is exactly what overlap reports. The range is split
+  // into O(log m) nodes that are each checked with a binary search, O(log² m) in all.
+  bool overlaps(const Rectangle& r) const
+  {
+    if (this->fixed_coordinates.empty())
+    {
+      return false;
+    }
+    const auto [fixed_low, fixed_high, span_low, span_high] =
+        this->fixed_dim == Dim::X ? tuple{r.left, r.right, r.bottom, r.top}
+                                  : tuple{r.bottom, r.top, r.left, r.right};
+    const auto& keys  = this->fixed_coordinates;
+    const auto  first = static_cast<size_t>(ranges::upper_bound(keys, fixed_low) - keys.begin());
+    const auto  last  = static_cast<size_t>(ranges::lower_bound(keys, fixed_high) - keys.begin());
+    return this->query(1, 0, keys.size(), first, last, span_low, span_high);
+  }
+
+ private:
+  struct Edge
+  {
+    int64_t fixed;
+    int64_t span_start;
+    int64_t span_stop;
+  };
+  struct Node
+  {
+    vector<int64_t> span_starts;    // Ascending
+    vector<int64_t> highest_stops;  // Highest stop among the spans up to here
+  };
+  // Returns the spans of the node's edges sorted on their start, merged from its children
+  vector<pair<int64_t, int64_t>> build(size_t              node,
+                                       size_t              node_first,
+                                       size_t              node_last,
+                                       const vector<Edge>& edges)
+  {
+    vector<pair<int64_t, int64_t>> spans;
+    if (node_last - node_first == 1)
+    {
+      spans.emplace_back(edges[node_first].span_start, edges[node_first].span_stop);
+    }
+    else
+    {
+      const auto mid   = node_first + (node_last - node_first) / 2;
+      const auto below = this->build(2 * node, node_first, mid, edges);
+      const auto above = this->build(2 * node + 1, mid, node_last, edges);
+      spans.reserve(below.size() + above.size());
+      ranges::merge(below, above, back_inserter(spans));
+    }
+    auto& [span_starts, highest_stops] = this->nodes[node];
+    int64_t highest_stop               = numeric_limits<int64_t>::min();
+    for (const auto& [span_start, span_stop] : spans)
+    {
+      highest_stop = max(highest_stop, span_stop);
+      span_starts.push_back(span_start);
+      highest_stops.push_back(highest_stop);
+    }
+    return spans;
+  }
+  bool query(size_t  node,
+             size_t  node_first,
+             size_t  node_last,
+             size_t  first,
+             size_t  last,
+             int64_t span_low,
+             int64_t span_high) const
+  {
+    if (node_last <= first || last <= node_first)
+    {
+      return false;
+    }
+    if (first <= node_first && node_last <= last)
+    {
+      // Of the spans starting below span_high, the one stopping highest decides
+      const auto& [span_starts, highest_stops] = this->nodes[node];
+      const auto count = ranges::lower_bound(span_starts, span_high) - span_starts.begin();
+      return count > 0 && highest_stops[count - 1] > span_low;
+    }
+    const auto mid = node_first + (node_last - node_first) / 2;
+    return this->query(2 * node, node_first, mid, first, last, span_low, span_high) ||
+           this->query(2 * node + 1, mid, node_last, first, last, span_low, span_high);
+  }
+  int             fixed_dim;
+  vector<int64_t> fixed_coordinates;
+  vector<Node>    nodes;
+};
+
+int64_t biggest_area_indexed(const vector<Coordinates>& coordinates,
+                             const vector<LineSegment>& line_segments)
+{
+  const EdgeIndex vertical(line_segments, Dim::X);
+  const EdgeIndex horizontal(line_segments, Dim::Y);
+  int64_t         biggest_area = 0;
+  for (const auto& [i, c] : coordinates | ranges::views::enumerate)
+  {
+    for (const auto& d : coordinates | ranges::views::drop(i + 1))
+    {
+      Rectangle  r{c, d};
+      const auto area = r.area();
+      if (area < biggest_area)
+      {
+        continue;
+      }
+      if (!vertical.overlaps(r) && !horizontal.overlaps(r))
+      {
+        biggest_area = area;
+      }
+    }
+  }
+  return biggest_area;
+}
+
+int64_t solve2_indexed(const string& file_name)
+{
+  const auto the_coordinates = read_file(file_name);
+  bool       left_is_outside;
+  const auto the_line_segments = get_line_segments(the_coordinates, left_is_outside);
+  return biggest_area_indexed(the_coordinates, the_line_segments);
+}
+
+// Polygon rasterised onto its compressed coordinates. Even indices are the distinct tile
+// coordinates and odd indices the gaps between them, so each cell is either wholly inside or
+// wholly outside. A prefix-sum table over the outside cells that hold at least one tile answers
+// whether a rectangle is fully inside in O(1), with none of the caveats of overlap.
+class CompressedGrid
+{
+ public:
+  explicit CompressedGrid(span<const Tile> polygon)
+  {
+    for (const auto& tile : polygon)
+    {
+      this->xs.push_back(tile.x);
+      this->ys.push_back(tile.y);
+    }
+    ranges::sort(this->xs);
+    ranges::sort(this->ys);
+    this->xs.erase(ranges::unique(this->xs).begin(), this->xs.end());
+    this->ys.erase(ranges::unique(this->ys).begin(), this->ys.end());
+    this->width  = 2 * this->xs.size() - 1;
+    this->height = 2 * this->ys.size() - 1;
+
+    // Mark the edges, and flag vertical edges at the rows strictly between their ends
+    vector<uint8_t> inside(this->width * this->height, 0);
+    vector<uint8_t> crossing(this->width * this->height, 0);
+    for (size_t i = 0; i < polygon.size(); ++i)
+    {
+      const auto& a      = polygon[i];
+      const auto& b      = polygon[(i + 1) % polygon.size()];
+      const auto  x_low  = this->compress_x(min(a.x, b.x));
+      const auto  x_high = this->compress_x(max(a.x, b.x));
+      const auto  y_low  = this->compress_y(min(a.y, b.y));
+      const auto  y_high = this->compress_y(max(a.y, b.y));
+      for (auto y = y_low; y <= y_high; ++y)
+      {
+        for (auto x = x_low; x <= x_high; ++x)
+        {
+          inside[y * this->width + x] = 1;
+        }
+      }
+      if (x_low == x_high && y_low < y_high)
+      {
+        crossing[(y_low + 1) * this->width + x_low] ^= 1;
+        crossing[y_high * this->width + x_low] ^= 1;
+      }
+    }
+    for (size_t i = this->width; i < crossing.size(); ++i)
+    {
+      crossing[i] ^= crossing[i - this->width];
+    }
+
+    // Scan the gap rows left to right counting crossings. Rows through tile coordinates are
+    // ambiguous there, but off the edges they match the gap row above them.
+    for (size_t y = this->height; y-- > 0;)
+    {
+      uint8_t parity = 0;
+      for (size_t x = 0; x < this->width; ++x)
+      {
+        const auto cell = y * this->width + x;
+        parity ^= crossing[cell];
+        if (y % 2 == 1)
+        {
+          inside[cell] |= parity;
+        }
+        else if (y + 1 < this->height)
+        {
+          inside[cell] |= inside[cell + this->width];
+        }
+      }
+    }
+
+    this->outside_prefix.assign((this->width + 1) * (this->height + 1), 0);
+    for (size_t y = 0; y < this->height; ++y)
+    {
+      for (size_t x = 0; x < this->width; ++x)
+      {
+        const uint32_t outside =
+            !inside[y * this->width + x] && this->has_tiles(this->xs, x) &&
+            this->has_tiles(this->ys, y);
+        this->outside_prefix[(y + 1) * (this->width + 1) + x + 1] =
+            outside + this->outside_prefix[y * (this->width + 1) + x + 1] +
+            this->outside_prefix[(y + 1) * (this->width + 1) + x] -
+            this->outside_prefix[y * (this->width + 1) + x];
+      }
+    }
+  }
+  // True when every tile of the rectangle spanned by two polygon corners is inside
+  bool contains(const Tile& a, const Tile& b) const
+  {
+    const auto x_low   = this->compress_x(min(a.x, b.x));
+    const auto x_high  = this->compress_x(max(a.x, b.x)) + 1;
+    const auto y_low   = this->compress_y(min(a.y, b.y));
+    const auto y_high  = this->compress_y(max(a.y, b.y)) + 1;
+    const auto columns = this->width + 1;
+    return this->outside_prefix[y_high * columns + x_high] -
+               this->outside_prefix[y_low * columns + x_high] -
+               this->outside_prefix[y_high * columns + x_low] +
+               this->outside_prefix[y_low * columns + x_low] ==
+           0;
+  }
+
+ private:
+  size_t compress_x(int64_t x) const
+  {
+    return 2 * static_cast<size_t>(ranges::lower_bound(this->xs, x) - this->xs.begin());
+  }
+  size_t compress_y(int64_t y) const
+  {
+    return 2 * static_cast<size_t>(ranges::lower_bound(this->ys, y) - this->ys.begin());
+  }
+  // Gaps between neighbouring coordinates are empty when the coordinates are adjacent
+  static bool has_tiles(const vector<int64_t>& coordinates, size_t index)
+  {
+    return index % 2 == 0 || coordinates[index / 2 + 1] - coordinates[index / 2] > 1;
+  }
+  vector<int64_t>  xs;
+  vector<int64_t>  ys;
+  size_t           width  = 0;
+  size_t           height = 0;
+  vector<uint32_t> outside_prefix;
+};
+
+int64_t biggest_area_compressed(span<const Tile> polygon)
+{
+  const CompressedGrid grid(polygon);
+  int64_t              biggest_area = 0;
+  for (size_t i = 0; i < polygon.size(); ++i)
+  {
+    for (size_t j = i + 1; j < polygon.size(); ++j)
+    {
+      const auto area = area_between(polygon[i], polygon[j]);
+      if (area > biggest_area && grid.contains(polygon[i], polygon[j]))
+      {
+        biggest_area = area;
+      }
+    }
+  }
+  return biggest_area;
+}
+
+int64_t solve2_compressed(const string& file_name)
+{
+  return biggest_area_compressed(to_tiles(read_file(file_name)));
+}
+
+// Corners are taken in order of the biggest area they could span within the bounding box, and
+// each is paired only with corners later in that order. A pool of threads picks up corners one
+// at a time, tries their partners by descending area and shares the best area found so far, so
+// everything at or below it is skipped and the search stops once no corner can beat it.
+int64_t biggest_area_parallel(span<const Tile> polygon,
+                              size_t           num_threads = thread::hardware_concurrency())
+{
+  const CompressedGrid grid(polygon);
+  const auto [x_min, x_max] = ranges::minmax(polygon | ranges::views::transform(&Tile::x));
+  const auto [y_min, y_max] = ranges::minmax(polygon | ranges::views::transform(&Tile::y));
+  vector<pair<int64_t, size_t>> corners;
+  for (const auto& [i, tile] : polygon | ranges::views::enumerate)
+  {
+    const auto bound = (max(tile.x - x_min, x_max - tile.x) + 1) *
+                       (max(tile.y - y_min, y_max - tile.y) + 1);
+    corners.emplace_back(bound, static_cast<size_t>(i));
+  }
+  ranges::sort(corners, greater{});
+
+  num_threads = clamp<size_t>(num_threads, 1, max<size_t>(corners.size(), 1));
+  atomic<int64_t> biggest_area = 0;
+  atomic<size_t>  next_corner  = 0;
+  {
+    vector<jthread> workers;
+    for (size_t t = 0; t < num_threads; ++t)
+    {
+      workers.emplace_back(
+          [&]()
+          {
+            vector<pair<int64_t, size_t>> partners;
+            for (size_t k = next_corner++; k < corners.size(); k = next_corner++)
+            {
+              const auto& [bound, i] = corners[k];
+              if (bound <= biggest_area.load(memory_order_relaxed))
+              {
+                break;
+              }
+              partners.clear();
+              for (const auto& j : corners | ranges::views::drop(k + 1) | ranges::views::values)
+              {
+                const auto area = area_between(polygon[i], polygon[j]);
+                if (area > biggest_area.load(memory_order_relaxed))
+                {
+                  partners.emplace_back(area, j);
+                }
+              }
+              ranges::sort(partners, greater{});
+              for (const auto& [area, j] : partners)
+              {
+                auto best = biggest_area.load(memory_order_relaxed);
+                if (area <= best)
+                {
+                  break;
+                }
+                if (grid.contains(polygon[i], polygon[j]))
+                {
+                  while (area > best && !biggest_area.compare_exchange_weak(best, area))
+                  {
+                  }
+                  break;
+                }
+              }
+            }
+          });
+    }
+  }
+  return biggest_area.load();
+}
+
+int64_t solve2_parallel(const string& file_name,
+                        size_t        num_threads = thread::hardware_concurrency())
+{
+  return biggest_area_parallel(to_tiles(read_file(file_name)), num_threads);
+}
+
 int64_t solve2(const string& file_name)
 {
   const auto the_coordinates = read_file(file_name);
@@ -261,6 +768,8 @@ int main()
   println("Answer  part 1: {} ({})", part1, duration_cast<microseconds>(duration1));
   const int64_t CORRECT_ANSWER_PART_1 = 4767418746;
   assert(part1 == CORRECT_ANSWER_PART_1);
+  assert(solve1_extreme(EXAMPLE_FILE, 0) == CORRECT_ANSWER_EXAMPLE_1);
+  assert(solve1_extreme(INPUT_FILE) == CORRECT_ANSWER_PART_1);
 
   const int64_t example2 = solve2(EXAMPLE_FILE);
   println("Example part 2: {}", example2);
@@ -273,4 +782,10 @@ int main()
   println("Answer  part 2: {} ({})", part2, duration_cast<microseconds>(duration2));
   const int64_t CORRECT_ANSWER_PART2 = 1461987144;
   assert(part2 == CORRECT_ANSWER_PART2);
+  assert(solve2_compressed(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+  assert(solve2_compressed(INPUT_FILE) == CORRECT_ANSWER_PART2);
+  assert(solve2_indexed(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+  assert(solve2_indexed(INPUT_FILE) == CORRECT_ANSWER_PART2);
+  assert(solve2_parallel(EXAMPLE_FILE) == CORRECT_ANSWER_EXAMPLE_2);
+  assert(solve2_parallel(INPUT_FILE) == CORRECT_ANSWER_PART2);
 };
\ No newline at end of file